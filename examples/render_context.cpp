@@ -0,0 +1,62 @@
+// a client of librender: loads a scene once and renders it at every
+// size given, into buffers of its own, written as <prefix>_<w>x<h>.ppm
+//
+//   make lib
+//   g++ -std=c++20 -O2 -pthread -Isrc -Ivecmath/include examples/render_context.cpp librender.a -o render_context
+//   ./render_context scene/default/scene10_sphere.txt output/sphere 320x240 160x120 -- -shadows -bounces 4
+#include "RenderContext.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, const char *argv[]) {
+    if (argc < 4) {
+        printf("usage: %s scene.txt prefix WxH... [-- options]\n", argv[0]);
+        return 1;
+    }
+    vector<pair<int, int>> sizes;
+    vector<string> options;
+    int i = 3;
+    for (; i < argc && strcmp(argv[i], "--") != 0; ++i) {
+        int w, h;
+        if (sscanf(argv[i], "%dx%d", &w, &h) != 2) {
+            printf("bad size %s\n", argv[i]);
+            return 1;
+        }
+        sizes.push_back({w, h});
+    }
+    for (++i; i < argc; ++i) {
+        options.push_back(argv[i]);
+    }
+
+    RenderContext context;
+    string error;
+    if (!context.setOptions(options, error) || !context.load(argv[1], ResourceProvider::files(), &error)) {
+        printf("%s\n", error.c_str());
+        return 1;
+    }
+    for (auto [w, h] : sizes) {
+        context.setSize(w, h);
+        int width = context.getImageWidth(), height = context.getImageHeight();
+        vector<unsigned char> rgba(width * height * 4);
+        context.render(rgba.data());
+        const RenderContextStats &stats = context.getStats();
+        printf("%dx%d: %.1f ms, %lld rays\n", width, height, stats.milliseconds, stats.rays.total());
+
+        string filename = string(argv[2]) + "_" + to_string(w) + "x" + to_string(h) + ".ppm";
+        FILE *file = fopen(filename.c_str(), "wb");
+        if (file == NULL) {
+            printf("cannot write %s\n", filename.c_str());
+            return 1;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        for (int p = 0; p < width * height; ++p) {
+            fwrite(&rgba[p * 4], 1, 3, file);
+        }
+        fclose(file);
+    }
+    return 0;
+}
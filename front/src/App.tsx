@@ -15,7 +15,7 @@ import { clamp, cstLocationToMonacoRange, useEditor } from './utils';
 
 import './App.scss'
 
-import initModule, { ModuleProgressEvent, WebModule } from 'web'
+import initModule, { ModuleEvent, ModuleProgressEvent, WebModule } from 'web'
 import 'web/index.data'
 import 'web/index.wasm'
 import { argsToFlags, Arguments, defaultArguments, filterPathTree, isArgsValid, parseModuleArgs, PathTreeNode, recursivelyMkdirForPath, rootDirectories, walkModuleFileSystem } from './binding';
@@ -192,8 +192,8 @@ export const App = () => {
         const model = editor.getModel()
         if (!model || !isEditorEdited)
             return
-        const { FS } = module
-        FS.writeFile(selectedFile, model.getValue())
+        // the renders parse the text from memory, it is not written to FS
+        module.setResource(selectedFile, model.getValue())
         setEditorEdited(false)
     }, [isSaving])
 
@@ -263,7 +263,8 @@ export const App = () => {
             editor.getModel()?.dispose()
             if (selectedFile) {
                 if (parsePath(selectedFile).base.match(/^scene.+\.txt$/)) {
-                    const selectedFileContent = new TextDecoder().decode(module.FS.readFile(selectedFile))
+                    const selectedFileContent = module.getResource(selectedFile)
+                        ?? new TextDecoder().decode(module.FS.readFile(selectedFile))
 
                     editor.updateOptions({ readOnly: false })
                     const model = monaco.editor.createModel(
@@ -317,8 +318,13 @@ export const App = () => {
         recursivelyMkdirForPath(module, moduleArgs.outputFile)
 
         stopRunning.current = 0
-        function renderCallback(e: ModuleProgressEvent) {
-            setModuleStatus(e)
+        function renderCallback(e: ModuleEvent) {
+            if ('percentage' in e) {
+                setModuleStatus(e)
+            } else if (module && isArgsValid(moduleArgs)) {
+                // a progressive pass has been written to the output file
+                setImgUrl(readImage(module, moduleArgs.outputFile))
+            }
             return stopRunning.current
         }
 
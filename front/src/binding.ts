@@ -26,6 +26,10 @@ export type Arguments = {
     jitter?: boolean
     filter?: boolean
 
+    // progressive rendering
+    spp?: number
+    timeBudget?: number
+
     // renderer
     rayCasting?: boolean
 
@@ -63,6 +67,14 @@ export function argsToFlags(args: Arguments): string[] {
     if (args.filter) {
         res.push('-filter')
     }
+    if (args.spp) {
+        res.push('-spp')
+        res.push(`${args.spp}`)
+    }
+    if (args.timeBudget) {
+        res.push('-time-budget')
+        res.push(`${args.timeBudget}`)
+    }
     if (args.rayCasting) {
         res.push('-casting')
     }
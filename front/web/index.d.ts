@@ -1,23 +1,36 @@
 declare module 'web' {
     export enum ModuleEventType {
         Progress = 0,
+        Pass = 1,
     }
     
     export type ModuleProgressEvent = {
         type: ModuleEventType.Progress
         percentage: number
     }
+
+    export type ModulePassEvent = {
+        type: ModuleEventType.Pass
+        spp: number
+    }
     
-    export type ModuleEvent = ModuleProgressEvent
+    export type ModuleEvent = ModuleProgressEvent | ModulePassEvent
 
     export interface WebModule extends EmscriptenModule {
         FS: typeof FS
         StringVector: new () => WebModule.StringVector
         exec(
             argvec: WebModule.StringVector,
-            callback: (event: ModuleProgressEvent) => number, // return 0 for continue, 1 for exit
+            callback: (event: ModuleEvent) => number, // return 0 for continue, 1 for exit
             callbackFreq: number
         ): Promise<void> | string
+
+        // files served to the renders instead of those of FS, such as the
+        // text of the editor
+        setResource(path: string, contents: string | Uint8Array): void
+        removeResource(path: string): void
+        // the text set for path, null if it is read from FS
+        getResource(path: string): string | null
     }
 
     export namespace WebModule {
@@ -0,0 +1,303 @@
+#include "Bench.h"
+#include "Entry.h"
+#include "data/Scene.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static const char *benchScenes[] = {
+    "scene/default/scene01_plane.txt",
+    "scene/default/scene02_cube.txt",
+    "scene/default/scene03_sphere.txt",
+    "scene/default/scene04_axes.txt",
+    "scene/default/scene05_bunny_200.txt",
+    "scene/default/scene06_bunny_1k.txt",
+    "scene/default/scene07_shine.txt",
+    "scene/default/scene08_c.txt",
+    "scene/default/scene09_s.txt",
+    "scene/default/scene10_sphere.txt",
+    "scene/default/scene11_cube.txt",
+    "scene/default/scene12_vase.txt",
+    "scene/default/scene13_diamond.txt",
+    "scene/block/sceneA1.txt",
+};
+
+struct BenchConfig {
+    const char *name;
+    vector<string> flags;
+};
+
+const BenchConfig benchConfigs[] = {
+    {"casting", {"-casting"}},
+    {"tracing", {}},
+    {"shadows", {"-shadows"}},
+    {"jitter", {"-shadows", "-jitter", "-filter"}},
+    {"blurry", {"-casting", "-blurry", "3.5"}},
+};
+
+struct BenchRun {
+    string scene;
+    string config;
+    double medianMs = 0;
+    double minMs = 0;
+    RayCounts rays;
+    // from the baseline, negative without one
+    double baselineMs = -1;
+    bool regression = false;
+
+    double raysPerSec() const {
+        return medianMs > 0 ? rays.total() / (medianMs / 1000) : 0;
+    }
+};
+
+///@brief name of a scene file without its directory and extension
+static string sceneName(const string &path) {
+    size_t slash = path.find_last_of('/');
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+static string toJson(const BenchRun &run) {
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+                     "{\"scene\": \"%s\", \"config\": \"%s\", \"median_ms\": %.3f, \"min_ms\": %.3f, "
+                     "\"rays_per_sec\": %.0f, \"primary\": %lld, \"secondary\": %lld, \"shadow\": %lld",
+                     run.scene.c_str(), run.config.c_str(), run.medianMs, run.minMs, run.raysPerSec(),
+                     run.rays.primary, run.rays.secondary, run.rays.shadow);
+    if (run.baselineMs >= 0) {
+        snprintf(buf + n, sizeof(buf) - n, ", \"baseline_ms\": %.3f, \"regression\": %s}",
+                 run.baselineMs, run.regression ? "true" : "false");
+    } else {
+        snprintf(buf + n, sizeof(buf) - n, "}");
+    }
+    return buf;
+}
+
+///@brief the fields of a run written by toJson: a flat object on one
+/// line, followed by nothing or a comma, with strings without escapes,
+/// which are returned without their quotes, and other values as written
+///@return false if line is not such an object
+static bool parseJsonRun(const string &line, map<string, string> &fields) {
+    size_t pos = 0;
+    auto skipSpace = [&]() {
+        while (pos < line.size() && isspace((unsigned char)line[pos])) {
+            ++pos;
+        }
+    };
+    auto expect = [&](char c) {
+        skipSpace();
+        if (pos < line.size() && line[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    };
+    auto readString = [&](string &s) {
+        if (!expect('"')) {
+            return false;
+        }
+        size_t end = line.find('"', pos);
+        if (end == string::npos) {
+            return false;
+        }
+        s = line.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    };
+    if (!expect('{')) {
+        return false;
+    }
+    do {
+        string key, value;
+        if (!readString(key) || !expect(':')) {
+            return false;
+        }
+        skipSpace();
+        if (pos < line.size() && line[pos] == '"') {
+            if (!readString(value)) {
+                return false;
+            }
+        } else {
+            size_t end = line.find_first_of(",} \t", pos);
+            if (end == string::npos || end == pos) {
+                return false;
+            }
+            value = line.substr(pos, end - pos);
+            pos = end;
+        }
+        fields[key] = value;
+    } while (expect(','));
+    if (!expect('}')) {
+        return false;
+    }
+    expect(',');
+    skipSpace();
+    return pos == line.size();
+}
+
+///@brief value as a number, false if it is not all one
+static bool parseNumber(const string &value, double &number) {
+    char *end;
+    number = strtod(value.c_str(), &end);
+    return !value.empty() && *end == '\0';
+}
+
+///@brief the runs of a saved report, by scene and configuration; the
+/// report has one run per line, as written by runBenchmark
+static map<string, BenchRun> loadBaseline(const char *filename) {
+    map<string, BenchRun> runs;
+    ifstream file(filename);
+    for (string line; getline(file, line);) {
+        map<string, string> fields;
+        if (!parseJsonRun(line, fields) || !fields.count("scene") || !fields.count("config") ||
+            !fields.count("median_ms")) {
+            continue;
+        }
+        BenchRun run;
+        run.scene = fields["scene"];
+        run.config = fields["config"];
+        if (!parseNumber(fields["median_ms"], run.medianMs)) {
+            continue;
+        }
+        long long *counts[3] = {&run.rays.primary, &run.rays.secondary, &run.rays.shadow};
+        const char *keys[3] = {"primary", "secondary", "shadow"};
+        for (int k = 0; k < 3; ++k) {
+            double count;
+            if (fields.count(keys[k]) && parseNumber(fields[keys[k]], count)) {
+                *counts[k] = (long long)count;
+            }
+        }
+        runs[run.scene + " " + run.config] = run;
+    }
+    return runs;
+}
+
+int runBenchmark(const Arguments &args, const CancellationToken *token) {
+    vector<string> scenes;
+    if (args.inputFile != NULL) {
+        scenes.push_back(args.inputFile);
+    } else {
+        scenes.assign(begin(benchScenes), end(benchScenes));
+    }
+    map<string, BenchRun> baseline;
+    if (args.benchBaseline != NULL) {
+        baseline = loadBaseline(args.benchBaseline);
+        if (baseline.empty()) {
+            cerr << "cannot read benchmark baseline " << args.benchBaseline << endl;
+            return 1;
+        }
+    }
+    // the summary goes to stdout, everything the renderer prints goes
+    // to stderr instead
+    cout.flush();
+    fflush(stdout);
+    FILE *summary = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    mkdir("output", 0755);
+    mkdir("output/bench", 0755);
+
+    using namespace std::chrono;
+    vector<BenchRun> runs;
+    int regressions = 0;
+    bool cancelled = false;
+    for (size_t s = 0; s < scenes.size() && !cancelled; ++s) {
+        if (!ifstream(scenes[s])) {
+            fprintf(summary, "skipping missing scene %s\n", scenes[s].c_str());
+            continue;
+        }
+        // loading and building the octrees is not timed
+        Scene scene(scenes[s].c_str());
+        if (!scene.getError().empty()) {
+            fprintf(summary, "skipping malformed scene %s\n", scene.getError().c_str());
+            continue;
+        }
+        for (const auto &config : benchConfigs) {
+            BenchRun run;
+            run.scene = sceneName(scenes[s]);
+            run.config = config.name;
+            vector<string> tokens{"proj", "-input", scenes[s],
+                                  "-size", to_string(args.width), to_string(args.height),
+                                  "-output", "output/bench/" + run.scene + "_" + run.config + ".bmp"};
+            tokens.insert(tokens.end(), config.flags.begin(), config.flags.end());
+            vector<const char *> argv;
+            for (auto &t : tokens) {
+                argv.push_back(t.c_str());
+            }
+            const Arguments runArgs(argv.size(), argv.data());
+            vector<double> ms;
+            Image img(0, 0);
+            for (int rep = 0; rep < args.benchReps && !cancelled; ++rep) {
+                // only the render is timed, the image of the last
+                // repetition is saved afterwards
+                img.reset(runArgs.width, runArgs.height);
+                auto t0 = steady_clock::now();
+                cancelled = !renderImage(runArgs, scene, img, [](double) {}, nullptr, token, NULL, NULL, run.rays);
+                ms.push_back(duration<double, milli>(steady_clock::now() - t0).count());
+            }
+            if (cancelled) {
+                break;
+            }
+            if (!img.saveImage(runArgs.outputFile)) {
+                fprintf(summary, "cannot write %s\n", runArgs.outputFile);
+            }
+            sort(ms.begin(), ms.end());
+            int n = ms.size();
+            run.medianMs = n % 2 ? ms[n / 2] : (ms[n / 2 - 1] + ms[n / 2]) / 2;
+            run.minMs = ms[0];
+
+            fprintf(summary, "%-20s %-8s %10.1f ms %8.2f Mrays/s", run.scene.c_str(), run.config.c_str(),
+                    run.medianMs, run.raysPerSec() / 1e6);
+            auto base = baseline.find(run.scene + " " + run.config);
+            if (base != baseline.end()) {
+                run.baselineMs = base->second.medianMs;
+                run.regression = run.medianMs > run.baselineMs * (1 + args.benchTolerance);
+                regressions += run.regression;
+                fprintf(summary, "  baseline %10.1f ms %+6.1f%%", run.baselineMs,
+                        100 * (run.medianMs / run.baselineMs - 1));
+                if (run.regression) {
+                    fprintf(summary, "  REGRESSION");
+                }
+                // the counts only change with the algorithms, not with the machine
+                if (base->second.rays.total() != run.rays.total()) {
+                    fprintf(summary, "  rays %lld -> %lld", base->second.rays.total(), run.rays.total());
+                }
+            }
+            fprintf(summary, "\n");
+            fflush(summary);
+            runs.push_back(run);
+        }
+    }
+
+    cout.flush();
+    fflush(stdout);
+    dup2(fileno(summary), STDOUT_FILENO);
+    fclose(summary);
+    const char *output = args.benchOutput != NULL ? args.benchOutput : "output/bench.json";
+    ofstream report(output);
+    report << "{\n\"reps\": " << args.benchReps << ", \"width\": " << args.width << ", \"height\": " << args.height
+           << ",\n\"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); ++i) {
+        report << toJson(runs[i]) << (i + 1 < runs.size() ? ",\n" : "\n");
+    }
+    report << "],\n\"regressions\": " << regressions << "\n}" << endl;
+    cout << "Benchmark report written to " << output << endl;
+    if (args.benchBaseline != NULL) {
+        cout << regressions << " regression(s) over " << args.benchTolerance * 100 << "% against "
+             << args.benchBaseline << endl;
+    }
+    if (cancelled) {
+        return 130;
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "render/Arguments.h"
+#include "render/Cancellation.h"
+
+///@brief renders scene01 to scene13 and sceneA1, or only args.inputFile
+/// when given, at args.width x args.height under the casting, tracing,
+/// shadows, jitter and blurry configurations, args.benchReps times each
+///
+/// a summary is printed to stdout, while the renderer's own messages go
+/// to stderr; the report is JSON, written to args.benchOutput or else to
+/// output/bench.json, with one run per line:
+///
+///     {"scene": "scene06_bunny_1k", "config": "shadows", "median_ms": 41.2,
+///      "min_ms": 40.8, "rays_per_sec": 3.1e6, "primary": 40000,
+///      "secondary": 61234, "shadow": 78123}
+///
+/// with args.benchBaseline, the runs are compared against those of a
+/// saved report and a median slower than the baseline by more than
+/// args.benchTolerance is flagged as a regression
+///@return 1 if a regression was found, 130 if cancelled, 0 otherwise
+int runBenchmark(const Arguments &args, const CancellationToken *token);
+
+#endif // BENCH_H
@@ -1,56 +1,212 @@
 #include "Entry.h"
+#include "RenderContext.h"
 #include "data/Camera.h"
 #include "data/Scene.h"
+#include "render/Denoiser.h"
 #include "render/Image.h"
 #include "render/RayCaster.h"
 #include "render/RayTracer.h"
+#include "render/Parallel.h"
 #include "render/Renderer.h"
+#include "render/Reprojection.h"
 #include "render/Smoothing.h"
+#include "render/ToneMapping.h"
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <string.h>
 
-const float kernel[5] = {0.1201, 0.2339, 0.2931, 0.2339, 0.1201};
+static const float kernel[5] = {0.1201, 0.2339, 0.2931, 0.2339, 0.1201};
 
-void entry(const Arguments &args, function<void(double)> onProgress) {
-    Scene scene(args.inputFile);
+///@return false if cancelled
+static bool renderColor(const Scene &scene, Image &img, RenderFunction &func,
+                 const Arguments &args, function<void(double)> onProgress,
+                 function<void(const Image &, int)> onPass,
+                 const CancellationToken *token, AovBuffers *aovs,
+                 ReprojectionCache *temporal) {
+    func.threads = args.threads > 0 ? args.threads : hardwareThreads();
+    if (args.progressive()) {
+        return Renderer::renderProgressive(scene, img, func, args.spp, args.timeBudget, onProgress, onPass, token, aovs);
+    } else if (args.adaptive) {
+        return Renderer::renderAdaptive(scene, img, func, args.adaptiveThreshold, args.adaptiveMaxSamples, onProgress, token, aovs);
+    } else if (temporal != NULL && !args.jitter) {
+        vector<bool> trace;
+        int n = temporal->reproject(scene.getCamera(), img, *aovs, trace, args.refreshFraction);
+        cout << "Reprojection: tracing " << n << " of " << img.getWidth() * img.getHeight() << " pixels" << endl;
+        bool done = Renderer::renderPixels(scene, img, func, trace, onProgress, token, aovs);
+        if (done) {
+            temporal->store(img, *aovs);
+        } else {
+            temporal->invalidate();
+        }
+        return done;
+    }
+    return Renderer::renderScene(scene, img, func, args.jitter, onProgress, token, aovs);
+}
+
+///@brief saves the color output, tone mapped unless it is a float format
+///@return false if the output file cannot be written
+static bool saveColor(const Image &img, const Arguments &args) {
+    if (!args.toneMap || Image::isFloatFormat(args.outputFile)) {
+        return img.saveImage(args.outputFile);
+    }
+    Image mapped(0, 0);
+    mapped.setImage(img);
+    ToneMapping::apply(mapped, args.toneMapOperator, args.exposure);
+    return mapped.saveImage(args.outputFile);
+}
+
+bool renderImage(const Arguments &args, Scene &scene, Image &img, function<void(double)> onProgress,
+                 function<void(const Image &, int)> onPass, const CancellationToken *token,
+                 AovBuffers *aovs, ReprojectionCache *temporal, RayCounts &rays) {
+    // a reused scene may still have the thin lens camera of a blurry render
+    scene.usePerspectiveCamera();
+    bool done;
+    if (args.rayCasting) {
+        if (args.blurry) {
+            BlurryRayCaster brc(args);
+            scene.setThinLensCamera(args.focus_dist);
+            done = renderColor(scene, img, brc, args, onProgress, onPass, token, aovs, temporal);
+            cout << brc.getLensStats() << endl;
+            rays = brc.rays;
+        } else {
+            RayCaster rc(args);
+            done = renderColor(scene, img, rc, args, onProgress, onPass, token, aovs, temporal);
+            rays = rc.rays;
+        }
+    } else {
+        RayTracer rt(args);
+        done = renderColor(scene, img, rt, args, onProgress, onPass, token, aovs, temporal);
+        rays = rt.rays;
+        if (args.shadows) {
+            cout << rt.getShadowStats() << endl;
+        }
+    }
+    // the adaptive and progressive samplers resolve their samples
+    // per pixel already
+    if (args.filter && !args.adaptive && !args.progressive()) {
+        if (args.filterRadius > 0) {
+            Smoothing::separable(img, Smoothing::weights(args.filterKernel, args.filterRadius));
+        } else {
+            Smoothing::separable(img, vector<float>(kernel, kernel + 5));
+        }
+        img.setSamplingRate(3);
+    }
+    if (args.denoise) {
+        assert(aovs != NULL);
+        auto t0 = chrono::steady_clock::now();
+        Denoiser::atrous(img, *aovs);
+        cout << "Denoising: " << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t0).count()
+             << " ms" << endl;
+    }
+    return done;
+}
+
+RenderResult entry(const Arguments &args, function<void(double)> onProgress,
+                   function<void(const Image &, int)> onPass,
+                   const CancellationToken *token, const ResourceProvider *resources) {
+    int len = strlen(args.inputFile);
+    if (len >= 4 && strcmp(".pfm", args.inputFile + len - 4) == 0) {
+        // a saved render, only tone mapped and converted to the output
+        RenderResult result;
+        Image *img = Image::loadPfm(args.inputFile);
+        if (img == NULL) {
+            result.error = string("cannot read ") + args.inputFile;
+            return result;
+        }
+        result.image = std::move(*img);
+        delete img;
+        if (args.outputFile && !saveColor(result.image, args)) {
+            result.error = string("cannot write ") + args.outputFile;
+        }
+        return result;
+    }
+    RenderContext context(args);
+    string error;
+    if (!context.load(args.inputFile, resources != NULL ? *resources : ResourceProvider::files(), &error)) {
+        RenderResult result;
+        result.error = error;
+        return result;
+    }
+    return context.renderFiles(onProgress, onPass, token);
+}
+
+RenderResult entry(const Arguments &args, Scene &scene, function<void(double)> onProgress,
+                   function<void(const Image &, int)> onPass,
+                   const CancellationToken *token, ReprojectionCache *temporal) {
+    RenderResult result;
+    // the counters of other renders at the same time go on, so this one
+    // prints what they grew by
+    RenderStats statsStart;
+    if (args.stats) {
+        statsStart = RenderStats::merged();
+    }
+    // a reused scene may still have the thin lens camera of a blurry render
+    scene.usePerspectiveCamera();
+    // the aovs come from the primary hits of the color pass, or from a
+    // pass of their own without a color output; they are only allocated
+    // for the outputs, reprojection and denoising that read them
+    bool needAovs = args.hasAovs() || temporal != NULL || args.denoise;
+    AovBuffers aovs(needAovs ? args.width : 0, needAovs ? args.height : 0);
+    AovBuffers *aovTarget = needAovs ? &aovs : NULL;
+    bool done = true;
     if (args.outputFile) {
+        // the reference is loaded first, not to render for nothing
+        unique_ptr<Image> reference;
+        if (args.referenceFile) {
+            reference.reset(Image::loadImage(args.referenceFile));
+            if (reference == NULL) {
+                result.error = string("cannot read reference image ") + args.referenceFile;
+                return result;
+            }
+        }
         Image img(args.width, args.height);
-        if (args.rayCasting) {
-            if (args.blurry) {
-                BlurryRayCaster brc(args);
-                scene.setThinLensCamera(args.focus_dist);
-                Renderer::renderScene(scene, img, brc, args.jitter, onProgress);
+        done = renderImage(args, scene, img, onProgress, onPass, token, aovTarget, temporal, result.rays);
+        if (reference != NULL) {
+            if (reference->getSampledWidth() != img.getSampledWidth() ||
+                reference->getSampledHeight() != img.getSampledHeight()) {
+                result.error = string("the reference image ") + args.referenceFile + " is " +
+                               to_string(reference->getSampledWidth()) + "x" +
+                               to_string(reference->getSampledHeight()) + ", the output " +
+                               to_string(img.getSampledWidth()) + "x" + to_string(img.getSampledHeight());
             } else {
-                RayCaster rc(args);
-                Renderer::renderScene(scene, img, rc, args.jitter, onProgress);
+                cout << "PSNR against " << args.referenceFile << ": " << Image::psnr(img, *reference) << " dB"
+                     << endl;
             }
-        } else {
-            RayTracer rt(args);
-            Renderer::renderScene(scene, img, rt, args.jitter, onProgress);
         }
-        if (args.filter) {
-            Smoothing::gaussian(img, kernel);
-            img.setSamplingRate(3);
+        if (!saveColor(img, args)) {
+            result.error = string("cannot write ") + args.outputFile;
+        } else if (!done) {
+            cout << "Render cancelled, partial image saved to " << args.outputFile << endl;
         }
-        img.saveImage(args.outputFile);
-    }
-
-    if (args.depthFile) {
+        result.image = std::move(img);
+    } else if (aovTarget != NULL) {
         Image img(args.width, args.height);
-        DepthRayCaster drc(args);
-        Renderer::renderScene(scene, img, drc, false, onProgress);
-        img.saveImage(args.depthFile);
+        AovRayCaster arc(args);
+        arc.threads = args.threads > 0 ? args.threads : hardwareThreads();
+        done = Renderer::renderScene(scene, img, arc, false, onProgress, token, aovTarget);
+        result.rays = arc.rays;
     }
 
-    if (args.normalsFile) {
-        Image img(args.width, args.height);
-        NormalsRayCaster nrc(args);
-        Renderer::renderScene(scene, img, nrc, false, onProgress);
-        img.saveImage(args.normalsFile);
+    for (int i = 0; i < NUM_AOVS; ++i) {
+        if (args.aovFiles[i] != NULL &&
+            !aovs.toImage((Aov)i, args, Image::isFloatFormat(args.aovFiles[i])).saveImage(args.aovFiles[i])) {
+            result.error = string("cannot write ") + args.aovFiles[i];
+        }
+    }
+    if (args.aovFiles[AOV_COST] != NULL) {
+        cout << "Cost heatmap: white at " << (long long)aovs.costScale(args.costSteps)
+             << (args.costSteps ? " steps" : " cycles") << " per sample, the 99th percentile" << endl;
+    }
+    if (args.stats) {
+        (RenderStats::merged() - statsStart).print(cout, scene);
     }
+    result.cancelled = !done;
+    result.aovs = std::move(aovs);
+    return result;
 }
@@ -1,9 +1,61 @@
 #ifndef ENTRY_H
 #define ENTRY_H
 
+#include "render/Aov.h"
 #include "render/Arguments.h"
+#include "render/Cancellation.h"
+#include "render/Image.h"
+#include "render/Renderer.h"
 #include <functional>
+#include <string>
 
-void entry(const Arguments &args, std::function<void(double)> onProgress);
+class ReprojectionCache;
+class ResourceProvider;
+class Scene;
+
+struct RenderResult {
+    ///@brief true if the token was cancelled before the render completed
+    bool cancelled = false;
+    ///@brief the color image, only partly rendered if cancelled; empty
+    /// without an output file
+    Image image = Image(0, 0);
+    ///@brief the primary hits of the pixels, empty without aov outputs
+    AovBuffers aovs = AovBuffers(0, 0);
+    ///@brief rays cast by the color pass, or by the aov pass without one
+    RayCounts rays;
+    ///@brief why nothing was rendered, such as a scene that cannot be
+    /// loaded, or an output that cannot be written; empty if neither
+    std::string error;
+};
+
+///@param onPass receives the image after every pass of progressive rendering
+///@param token stops the render after the tile in progress when cancelled,
+/// the partial color image and aovs are still saved
+///@param resources where the scene and its files are read from, the
+/// files on disk by default
+RenderResult entry(const Arguments &args, std::function<void(double)> onProgress,
+                   std::function<void(const Image &, int)> onPass = nullptr,
+                   const CancellationToken *token = NULL,
+                   const ResourceProvider *resources = NULL);
+
+///@brief renders the color image of scene as args asks, filtered and
+/// denoised, without saving it
+///@param img has the size of args, with -jitter it comes back with the
+/// 3x3 samples of every pixel, which -filter resolves
+///@param aovs gets the primary hits, it is needed by -denoise and temporal
+///@param rays receives the rays cast
+///@return false if cancelled
+bool renderImage(const Arguments &args, Scene &scene, Image &img, std::function<void(double)> onProgress,
+                 std::function<void(const Image &, int)> onPass, const CancellationToken *token,
+                 AovBuffers *aovs, ReprojectionCache *temporal, RayCounts &rays);
+
+///@brief renders an already loaded scene, so that it can be reused for
+/// the next request
+///@param temporal reuses the previous frame of an animation, the pixels
+/// it covers are not traced again
+RenderResult entry(const Arguments &args, Scene &scene, std::function<void(double)> onProgress,
+                   std::function<void(const Image &, int)> onPass = nullptr,
+                   const CancellationToken *token = NULL,
+                   ReprojectionCache *temporal = NULL);
 
 #endif // ENTRY_H
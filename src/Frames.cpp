@@ -0,0 +1,172 @@
+#include "Frames.h"
+#include "Entry.h"
+#include "ProgressBar.h"
+#include "data/Scene.h"
+#include "render/Reprojection.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+#define DegreesToRadians(x) ((M_PI * x) / 180.0f)
+
+static Vector3f readVector3f(istream &in) {
+    Vector3f v;
+    in >> v[0] >> v[1] >> v[2];
+    return v;
+}
+
+///@brief composes the transformations the same way as a Transform block
+/// of a scene file
+///@return false on an unknown transformation or a missing operand
+static bool readTransform(istream &in, Matrix4f &matrix) {
+    matrix = Matrix4f::identity();
+    for (string op; in >> op;) {
+        if (op == "Translate") {
+            matrix = matrix * Matrix4f::translation(readVector3f(in));
+        } else if (op == "Scale") {
+            Vector3f s = readVector3f(in);
+            matrix = matrix * Matrix4f::scaling(s[0], s[1], s[2]);
+        } else if (op == "UniformScale") {
+            float s;
+            in >> s;
+            matrix = matrix * Matrix4f::uniformScaling(s);
+        } else {
+            float degrees;
+            in >> degrees;
+            if (op == "XRotate") {
+                matrix = matrix * Matrix4f::rotateX(DegreesToRadians(degrees));
+            } else if (op == "YRotate") {
+                matrix = matrix * Matrix4f::rotateY(DegreesToRadians(degrees));
+            } else if (op == "ZRotate") {
+                matrix = matrix * Matrix4f::rotateZ(DegreesToRadians(degrees));
+            } else {
+                return false;
+            }
+        }
+        if (!in) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///@brief replaces light i of the scene, or reports the line that names
+/// a light the scene does not have and deletes light
+static bool setLight(Scene &scene, int i, Light *light, const char *file, int lineNumber) {
+    if (scene.setLight(i, light)) {
+        return true;
+    }
+    cout << file << ":" << lineNumber << ": the scene has no light " << i << endl;
+    delete light;
+    return false;
+}
+
+int renderFrames(const Arguments &args, const CancellationToken *token) {
+    ifstream file(args.framesFile);
+    if (!file) {
+        cout << "cannot open frames file " << args.framesFile << endl;
+        return 1;
+    }
+    Scene scene(args.inputFile);
+    if (!scene.getError().empty()) {
+        cout << scene.getError() << endl;
+        return 1;
+    }
+    // moved objects and changed lights invalidate what they cover, a
+    // moving camera is what reprojection is for
+    ReprojectionCache cache;
+    ReprojectionCache *temporal = args.reproject ? &cache : NULL;
+    Arguments frameArgs = args;
+    int frames = 0, lineNumber = 0;
+    for (string line; getline(file, line);) {
+        ++lineNumber;
+        istringstream in(line);
+        string command;
+        if (!(in >> command) || command[0] == '#') {
+            continue;
+        }
+        if (command == "camera") {
+            Vector3f center = readVector3f(in), direction = readVector3f(in), up = readVector3f(in);
+            if (!in) {
+                cout << args.framesFile << ":" << lineNumber << ": expected camera [center] [direction] [up]" << endl;
+                return 1;
+            }
+            scene.setCamera(center, direction, up);
+        } else if (command == "transform") {
+            int object;
+            Matrix4f matrix;
+            if (!(in >> object) || !readTransform(in, matrix)) {
+                cout << args.framesFile << ":" << lineNumber << ": bad transform '" << line << "'" << endl;
+                return 1;
+            }
+            if (!scene.setTransform(object, matrix)) {
+                cout << args.framesFile << ":" << lineNumber << ": object " << object
+                     << " is not a top-level Transform of the scene" << endl;
+                return 1;
+            }
+            Box bounds;
+            if (scene.getGroup().getObject(object)->getBounds(bounds)) {
+                cache.invalidateObject(object, bounds);
+            } else {
+                cache.invalidate();
+            }
+        } else if (command == "pointlight") {
+            int light;
+            float falloff;
+            in >> light;
+            Vector3f position = readVector3f(in), color = readVector3f(in);
+            in >> falloff;
+            if (!in) {
+                cout << args.framesFile << ":" << lineNumber
+                     << ": expected pointlight [light] [position] [color] [falloff]" << endl;
+                return 1;
+            }
+            if (!setLight(scene, light, new PointLight(position, color, falloff), args.framesFile, lineNumber)) {
+                return 1;
+            }
+            cache.invalidate();
+        } else if (command == "directionallight") {
+            int light;
+            in >> light;
+            Vector3f direction = readVector3f(in), color = readVector3f(in);
+            if (!in) {
+                cout << args.framesFile << ":" << lineNumber
+                     << ": expected directionallight [light] [direction] [color]" << endl;
+                return 1;
+            }
+            if (!setLight(scene, light, new DirectionalLight(direction, color), args.framesFile, lineNumber)) {
+                return 1;
+            }
+            cache.invalidate();
+        } else if (command == "frame") {
+            string output;
+            if (!(in >> output)) {
+                cout << args.framesFile << ":" << lineNumber << ": expected frame [outputFile]" << endl;
+                return 1;
+            }
+            frameArgs.outputFile = output.c_str();
+            using namespace std::chrono;
+            auto t0 = steady_clock::now();
+            scene.update();
+            auto result = entry(frameArgs, scene, printProgress, nullptr, token, temporal);
+            cout << "Frame " << frames++ << ": " << output << " in "
+                 << duration_cast<milliseconds>(steady_clock::now() - t0).count() << " ms" << endl;
+            if (!result.error.empty()) {
+                cout << result.error << endl;
+                return 1;
+            }
+            if (result.cancelled) {
+                return 130;
+            }
+        } else {
+            cout << args.framesFile << ":" << lineNumber << ": unknown command '" << command << "'" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
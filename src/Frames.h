@@ -0,0 +1,24 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include "render/Arguments.h"
+#include "render/Cancellation.h"
+
+///@brief renders an animation from args.framesFile, a list of updates
+/// to the scene of args.inputFile, one per line, and of frames to render
+/// with the scene as updated so far:
+///
+///     camera [center] [direction] [up]
+///     transform [object] [Translate x y z | Scale x y z | UniformScale s
+///                         | XRotate deg | YRotate deg | ZRotate deg]...
+///     pointlight [light] [position] [color] [falloff]
+///     directionallight [light] [direction] [color]
+///     frame [outputFile]
+///
+/// objects are the top-level objects of the scene group, counted from 0;
+/// the scene is loaded once and only refit between frames
+///@return 0, 130 if cancelled, 1 on a bad line, which is reported with
+/// its line number
+int renderFrames(const Arguments &args, const CancellationToken *token);
+
+#endif // FRAMES_H
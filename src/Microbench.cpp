@@ -0,0 +1,266 @@
+#include "Microbench.h"
+#include "data/Hit.h"
+#include "object3d/Mesh.h"
+#include "object3d/Plane.h"
+#include "object3d/Sphere.h"
+#include "object3d/Triangle.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// relative difference in t up to which two kernels agree
+#define T_TOLERANCE 1e-4f
+
+///@brief the triangle test by Moller and Trumbore, with edge vectors and
+/// cross products instead of the determinants of Cramer's rule
+class MollerTrumboreTriangle : public Triangle {
+public:
+    using Triangle::Triangle;
+    virtual bool intersect(const Ray &r, Hit &h, float tmin) {
+        auto rd = r.getDirection();
+        auto e1 = b - a, e2 = c - a;
+        auto p = Vector3f::cross(rd, e2);
+        float invDet = 1 / Vector3f::dot(e1, p);
+        auto s = r.getOrigin() - a;
+        float beta = Vector3f::dot(s, p) * invDet;
+        if (!(beta >= 0 && beta <= 1)) {
+            return false;
+        }
+        auto q = Vector3f::cross(s, e1);
+        float gamma = Vector3f::dot(rd, q) * invDet;
+        if (!(gamma >= 0 && beta + gamma <= 1)) {
+            return false;
+        }
+        float t = Vector3f::dot(e2, q) * invDet;
+        if (t > tmin && t < h.getT()) {
+            setHit(h, t, 1 - beta - gamma, beta, gamma);
+            return true;
+        }
+        return false;
+    }
+};
+
+///@brief the sphere test with half of b, which saves the factors of 2
+/// and 4, and the far root only computed when the near one is behind
+class HalfBSphere : public Sphere {
+public:
+    using Sphere::Sphere;
+    virtual bool intersect(const Ray &r, Hit &h, float tmin) {
+        auto Ro = r.getOrigin() - center;
+        auto Rd = r.getDirection();
+        float a = Rd.absSquared();
+        float halfB = Vector3f::dot(Rd, Ro);
+        float c = Ro.absSquared() - radius * radius;
+        float discriminant = halfB * halfB - a * c;
+        if (discriminant < 0) {
+            return false;
+        }
+        float root = sqrt(discriminant);
+        float t = (-halfB - root) / a;
+        if (t < tmin || t > h.getT()) {
+            t = (-halfB + root) / a;
+            if (t < tmin || t > h.getT()) {
+                return false;
+            }
+        }
+        h.set(t, material, (Ro + t * Rd).normalized());
+        return true;
+    }
+};
+
+struct Kernel {
+    const char *name;
+    // intersects the i-th ray
+    function<bool(int, const Ray &, Hit &)> intersect;
+    // runs only on the first rays / slowdown of them, for the slow ones
+    int slowdown = 1;
+};
+
+struct Workload {
+    string name;
+    vector<Ray> rays;
+    // the first is the one the renderer uses, the others are checked
+    // against it
+    vector<Kernel> kernels;
+};
+
+///@brief a ray from outside box toward a random point of box grown by
+/// a quarter, so that a part of the rays miss
+static Ray rayToward(const Box &box, mt19937 &rng) {
+    uniform_real_distribution<float> unit(0, 1);
+    Vector3f center = (box.mn + box.mx) / 2, extent = box.mx - box.mn;
+    float size = max(extent.abs(), 1e-3f);
+    Vector3f target;
+    for (int k = 0; k < 3; ++k) {
+        target[k] = center[k] + (unit(rng) - 0.5f) * 1.25f * max(extent[k], 1e-3f);
+    }
+    // uniform on the sphere of twice the size around the box
+    float z = 2 * unit(rng) - 1, phi = 2 * M_PI * unit(rng), rxy = sqrt(1 - z * z);
+    Vector3f origin = center + 2 * size * Vector3f(rxy * cos(phi), rxy * sin(phi), z);
+    return Ray(origin, (target - origin).normalized());
+}
+
+///@brief the triangles of mesh, one per ray, each ray aimed at its own
+/// triangle
+static Workload triangleWorkload(const Mesh &mesh, int n, mt19937 &rng) {
+    int count = mesh.t.size();
+    auto cramer = make_shared<vector<unique_ptr<Triangle>>>();
+    auto mollerTrumbore = make_shared<vector<unique_ptr<Triangle>>>();
+    Workload w;
+    w.name = "triangle";
+    for (int i = 0; i < count; ++i) {
+        const Vector3f &a = mesh.v[mesh.t[i][0]], &b = mesh.v[mesh.t[i][1]], &c = mesh.v[mesh.t[i][2]];
+        cramer->push_back(make_unique<Triangle>(a, b, c, nullptr));
+        mollerTrumbore->push_back(make_unique<MollerTrumboreTriangle>(a, b, c, nullptr));
+        for (int k = 0; k < 3; ++k) {
+            cramer->back()->normals[k] = mollerTrumbore->back()->normals[k] = mesh.n[i];
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        Box box;
+        (*cramer)[i % count]->getBounds(box);
+        w.rays.push_back(rayToward(box, rng));
+    }
+    w.kernels.push_back({"cramer", [cramer, count](int i, const Ray &r, Hit &h) {
+                             return (*cramer)[i % count]->intersect(r, h, 0);
+                         }});
+    w.kernels.push_back({"moller-trumbore", [mollerTrumbore, count](int i, const Ray &r, Hit &h) {
+                             return (*mollerTrumbore)[i % count]->intersect(r, h, 0);
+                         }});
+    return w;
+}
+
+static Workload sphereWorkload(int n, mt19937 &rng) {
+    auto quadratic = make_shared<Sphere>(Vector3f(0.5f, -0.25f, 0), 1.5f, nullptr);
+    auto halfB = make_shared<HalfBSphere>(Vector3f(0.5f, -0.25f, 0), 1.5f, nullptr);
+    Workload w;
+    w.name = "sphere";
+    Box box;
+    quadratic->getBounds(box);
+    for (int i = 0; i < n; ++i) {
+        w.rays.push_back(rayToward(box, rng));
+    }
+    w.kernels.push_back({"quadratic", [quadratic](int, const Ray &r, Hit &h) {
+                             return quadratic->intersect(r, h, 0);
+                         }});
+    w.kernels.push_back({"half-b", [halfB](int, const Ray &r, Hit &h) {
+                             return halfB->intersect(r, h, 0);
+                         }});
+    return w;
+}
+
+static Workload planeWorkload(int n, mt19937 &rng) {
+    auto plane = make_shared<Plane>(Vector3f(0.2f, 1, 0.1f), -0.5f, nullptr);
+    Workload w;
+    w.name = "plane";
+    Box box(Vector3f(-2, -0.5f, -2), Vector3f(2, -0.5f, 2));
+    for (int i = 0; i < n; ++i) {
+        w.rays.push_back(rayToward(box, rng));
+    }
+    w.kernels.push_back({"plane", [plane](int, const Ray &r, Hit &h) {
+                             return plane->intersect(r, h, 0);
+                         }});
+    return w;
+}
+
+///@brief rays at mesh through its octree, and through all of its
+/// triangles as ray casting does, on a hundredth of the rays
+static Workload meshWorkload(const string &name, shared_ptr<Mesh> mesh, int n, mt19937 &rng) {
+    Workload w;
+    w.name = "octree " + name;
+    Box box;
+    mesh->getBounds(box);
+    for (int i = 0; i < n; ++i) {
+        w.rays.push_back(rayToward(box, rng));
+    }
+    w.kernels.push_back({"octree", [mesh](int, const Ray &r, Hit &h) {
+                             return mesh->intersect(r, h, 0);
+                         }});
+    w.kernels.push_back({"brute force", [mesh](int, const Ray &r, Hit &h) {
+                             h.casting = true;
+                             return mesh->intersect(r, h, 0);
+                         },
+                         100});
+    return w;
+}
+
+///@return the number of disagreements of the alternative kernels
+static int runWorkload(const Workload &w) {
+    using namespace std::chrono;
+    int n = w.rays.size(), disagreements = 0;
+    vector<bool> refHit;
+    vector<float> refT;
+    for (size_t k = 0; k < w.kernels.size(); ++k) {
+        const Kernel &kernel = w.kernels[k];
+        int rays = max(1, n / kernel.slowdown);
+        vector<bool> hit(rays);
+        vector<float> t(rays);
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < rays; ++i) {
+            Hit h;
+            hit[i] = kernel.intersect(i, w.rays[i], h);
+            t[i] = h.getT();
+        }
+        double ns = duration<double, nano>(steady_clock::now() - t0).count() / rays;
+        int hits = 0, differ = 0;
+        for (int i = 0; i < rays; ++i) {
+            hits += hit[i];
+            if (k > 0) {
+                bool same = hit[i] == refHit[i] &&
+                            (!hit[i] || fabs(t[i] - refT[i]) <= T_TOLERANCE * max(1.0f, fabs(refT[i])));
+                differ += !same;
+            }
+        }
+        printf("%-20s %-16s %9d rays %10.1f ns/ray %6.1f%% hits", w.name.c_str(), kernel.name, rays, ns,
+               100.0 * hits / rays);
+        if (k == 0) {
+            refHit = hit;
+            refT = t;
+            printf("\n");
+        } else {
+            printf("  %d disagreements\n", differ);
+            disagreements += differ;
+        }
+    }
+    return disagreements;
+}
+
+int runMicrobenchmark(const Arguments &args) {
+    const char *meshes[] = {"bunny_200", "bunny_1k", "vase", "diamond", "cube"};
+    // the same rays on every run
+    mt19937 rng(6837);
+    vector<Workload> workloads;
+    int n = args.microbenchRays;
+    if (ifstream("scene/default/bunny_200.obj")) {
+        Mesh bunny("scene/default/bunny_200.obj", nullptr);
+        workloads.push_back(triangleWorkload(bunny, n, rng));
+    }
+    workloads.push_back(sphereWorkload(n, rng));
+    workloads.push_back(planeWorkload(n, rng));
+    for (const char *name : meshes) {
+        string path = string("scene/default/") + name + ".obj";
+        if (!ifstream(path)) {
+            printf("skipping missing mesh %s\n", path.c_str());
+            continue;
+        }
+        workloads.push_back(meshWorkload(name, make_shared<Mesh>(path.c_str(), nullptr), n, rng));
+    }
+
+    int disagreements = 0;
+    for (auto &w : workloads) {
+        disagreements += runWorkload(w);
+    }
+    if (disagreements > 0) {
+        printf("%d disagreements with the kernels of the renderer\n", disagreements);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include "render/Arguments.h"
+
+///@brief times the intersection kernels in isolation on deterministic
+/// random rays, args.microbenchRays per workload: the triangles of
+/// bunny_200, a sphere, a plane, and the octrees of the meshes of
+/// scene/default
+///
+/// every workload runs through its kernel in the renderer and through
+/// the alternative kernels, which must agree with it on the hits and
+/// their t; the ns per ray, hit rate and disagreements of each are
+/// printed
+///@return 1 if a kernel disagreed with the one of the renderer, 0 otherwise
+int runMicrobenchmark(const Arguments &args);
+
+#endif // MICROBENCH_H
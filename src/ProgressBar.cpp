@@ -8,7 +8,7 @@ using namespace std;
 #define LEFT_BRACKET "▕"
 #define RIGHT_BRACKET "▏"
 #define FULL_BLOCK "█"
-const char *partialBlocks[] = {" ", "▏", "▎", "▍", "▌", "▋", "▊", "▉"};
+static const char *partialBlocks[] = {" ", "▏", "▎", "▍", "▌", "▋", "▊", "▉"};
 void printProgress(double percentage) {
     int fullBlocks = (int)floor(percentage * LEN);
     int partialIndex = (int)(8 * LEN * (percentage - (double)fullBlocks / LEN));
@@ -0,0 +1,166 @@
+#include "RenderContext.h"
+#include "data/Scene.h"
+#include "render/Image.h"
+#include "render/ToneMapping.h"
+#include <cassert>
+#include <cstring>
+
+using namespace std;
+
+RenderContext::RenderContext() : args(make_unique<Arguments>()) {}
+
+RenderContext::RenderContext(const Arguments &args) : args(make_unique<Arguments>(args)) {}
+
+RenderContext::~RenderContext() {}
+
+bool RenderContext::setOptions(const vector<string> &options, string &error) {
+    // the arguments point into the strings, which moving the vector
+    // keeps where they are
+    vector<string> strings = options;
+    vector<const char *> argv(strings.size() + 1, "");
+    for (size_t i = 0; i < strings.size(); ++i) {
+        argv[i + 1] = strings[i].c_str();
+    }
+    auto parsed = make_unique<Arguments>();
+    if (!parsed->parse(argv.size(), argv.data(), error)) {
+        return false;
+    }
+    this->options = std::move(strings);
+    args = std::move(parsed);
+    return true;
+}
+
+bool RenderContext::load(const char *filename, const ResourceProvider &resources, string *error) {
+    int len = strlen(filename);
+    Resource file;
+    if (len < 4 || strcmp(".txt", filename + len - 4) != 0 || !resources.open(filename, file)) {
+        if (error != NULL) {
+            *error = string("cannot open scene file ") + filename;
+        }
+        return false;
+    }
+    scene.reset();
+    scene = make_unique<Scene>(filename, resources);
+    if (!scene->getError().empty()) {
+        if (error != NULL) {
+            *error = scene->getError();
+        }
+        scene.reset();
+        return false;
+    }
+    return true;
+}
+
+Scene &RenderContext::getScene() const {
+    assert(scene != nullptr);
+    return *scene;
+}
+
+void RenderContext::setSize(int width, int height) {
+    assert(width > 0 && height > 0);
+    args->width = width;
+    args->height = height;
+}
+
+void RenderContext::setCamera(const Vector3f &center, const Vector3f &direction, const Vector3f &up) {
+    getScene().setCamera(center, direction, up);
+}
+
+///@brief n pixels of the size set as renderImage gives them: -jitter
+/// renders 3x3 samples per pixel and -filter takes 3x3 samples for a
+/// pixel, the adaptive and progressive samplers do neither
+static int imageSize(const Arguments &args, int n) {
+    if (args.adaptive || args.progressive()) {
+        return n;
+    }
+    if (args.jitter) {
+        n *= 3;
+    }
+    if (args.filter) {
+        n /= 3;
+    }
+    return n;
+}
+
+int RenderContext::getImageWidth() const {
+    return imageSize(*args, args->width);
+}
+
+int RenderContext::getImageHeight() const {
+    return imageSize(*args, args->height);
+}
+
+void RenderContext::beginStats() {
+    stats = RenderContextStats();
+    statsStart = RenderStats::merged();
+    start = chrono::steady_clock::now();
+}
+
+void RenderContext::endStats(bool done) {
+    stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.cancelled = !done;
+    RenderStats counted = RenderStats::merged() - statsStart;
+    copy(counted.counters, counted.counters + NUM_STAT_COUNTERS, stats.counters);
+}
+
+bool RenderContext::renderColor(Image &img, function<void(double)> onProgress, const CancellationToken *token) {
+    Scene &scene = getScene();
+    if (!onProgress) {
+        onProgress = [](double) {};
+    }
+    beginStats();
+    // only the denoiser reads the primary hits here
+    AovBuffers aovs(args->denoise ? args->width : 0, args->denoise ? args->height : 0);
+    bool done = renderImage(*args, scene, img, onProgress, nullptr, token, args->denoise ? &aovs : NULL, NULL,
+                            stats.rays);
+    endStats(done);
+    assert(img.getSampledWidth() == getImageWidth() && img.getSampledHeight() == getImageHeight());
+    return done;
+}
+
+bool RenderContext::render(unsigned char *rgba, function<void(double)> onProgress, const CancellationToken *token) {
+    Image img(args->width, args->height);
+    bool done = renderColor(img, onProgress, token);
+    toRgba(img, rgba);
+    return done;
+}
+
+bool RenderContext::render(float *rgb, function<void(double)> onProgress, const CancellationToken *token) {
+    Image img(args->width, args->height);
+    bool done = renderColor(img, onProgress, token);
+    int width = img.getSampledWidth(), height = img.getSampledHeight();
+    vector<Vector3f> row(width);
+    for (int y = 0; y < height; ++y) {
+        // row 0 of an image is its bottom row
+        img.getSampledRow(height - 1 - y, row.data());
+        for (int x = 0; x < width; ++x) {
+            for (int k = 0; k < 3; ++k) {
+                rgb[(y * width + x) * 3 + k] = row[x][k];
+            }
+        }
+    }
+    return done;
+}
+
+RenderResult RenderContext::renderFiles(function<void(double)> onProgress, function<void(const Image &, int)> onPass,
+                                        const CancellationToken *token) {
+    if (!onProgress) {
+        onProgress = [](double) {};
+    }
+    beginStats();
+    RenderResult result = entry(*args, getScene(), onProgress, onPass, token);
+    stats.rays = result.rays;
+    endStats(!result.cancelled);
+    return result;
+}
+
+void RenderContext::toRgba(const Image &img, unsigned char *rgba) const {
+    if (!args->toneMap) {
+        img.toRgba(rgba);
+        return;
+    }
+    Image mapped(0, 0);
+    mapped.setImage(img);
+    ToneMapping::apply(mapped, args->toneMapOperator, args->exposure);
+    mapped.toRgba(rgba);
+}
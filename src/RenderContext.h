@@ -0,0 +1,114 @@
+#ifndef RENDERCONTEXT_H
+#define RENDERCONTEXT_H
+
+#include "Entry.h"
+#include "data/Resource.h"
+#include "render/Stats.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Scene;
+
+///@brief what the last render of a context did
+struct RenderContextStats {
+    bool cancelled = false;
+    double milliseconds = 0;
+    RayCounts rays;
+    ///@brief what the counters of RenderStats grew by during the render,
+    /// all zero unless built with make STATS=1; they are those of the
+    /// process, so they also count the renders of other contexts at the
+    /// same time
+    long long counters[NUM_STAT_COUNTERS] = {};
+};
+
+///@brief the renderer as a library (librender): a scene loaded once and
+/// rendered any number of times, at any size and from any camera, into
+/// buffers of the caller
+///
+/// the options are those of the command line; a context renders one
+/// image at a time, separate contexts can render at once
+class RenderContext {
+public:
+    ///@brief a context with the default options of the command line
+    RenderContext();
+    ///@brief a context with the options of args, whose strings must
+    /// outlive it
+    explicit RenderContext(const Arguments &args);
+    ~RenderContext();
+
+    ///@brief replaces the options with ones in the vocabulary of the
+    /// command line, e.g. {"-size", "320", "240", "-shadows"}; the output
+    /// files they name are only written by renderFiles
+    ///@return false if they are malformed, error then says why and the
+    /// options are left as they were
+    bool setOptions(const std::vector<std::string> &options, std::string &error);
+    const Arguments &getArguments() const {
+        return *args;
+    }
+
+    ///@brief loads the scene at filename from resources, which only has
+    /// to live during the call, in place of the loaded one
+    ///@return false if it is not a .txt file of resources or it is
+    /// malformed, no scene is loaded then
+    ///@param error gets why it was not loaded
+    bool load(const char *filename, const ResourceProvider &resources = ResourceProvider::files(),
+              std::string *error = NULL);
+    bool isLoaded() const {
+        return scene != nullptr;
+    }
+    ///@brief the loaded scene, to move its objects and lights between
+    /// renders; call update() on it after that
+    Scene &getScene() const;
+
+    ///@brief the size rendered, before supersampling
+    void setSize(int width, int height);
+    void setCamera(const Vector3f &center, const Vector3f &direction, const Vector3f &up);
+    ///@brief the size of the images render writes, as the command line
+    /// saves them: 3 times the size with -jitter without -filter, and a
+    /// third of it with -filter without -jitter
+    int getImageWidth() const;
+    int getImageHeight() const;
+
+    ///@brief renders the loaded scene into rgba, getImageWidth() *
+    /// getImageHeight() * 4 bytes from the top left with opaque alpha,
+    /// tone mapped as 8-bit outputs are saved
+    ///@param token stops the render after the tiles in progress, rgba
+    /// then holds what was rendered
+    ///@return false if cancelled
+    bool render(unsigned char *rgba, std::function<void(double)> onProgress = nullptr,
+                const CancellationToken *token = NULL);
+    ///@brief the same in linear RGB, 3 floats per pixel, before tone mapping
+    bool render(float *rgb, std::function<void(double)> onProgress = nullptr,
+                const CancellationToken *token = NULL);
+    ///@brief renders the loaded scene as the command line does, writing
+    /// the output files of the options
+    RenderResult renderFiles(std::function<void(double)> onProgress = nullptr,
+                             std::function<void(const Image &, int)> onPass = nullptr,
+                             const CancellationToken *token = NULL);
+    ///@brief the color image of a render to 8-bit RGBA from the top left,
+    /// tone mapped as render does, its sampled size
+    void toRgba(const Image &img, unsigned char *rgba) const;
+
+    const RenderContextStats &getStats() const {
+        return stats;
+    }
+
+private:
+    // the strings args points into
+    std::vector<std::string> options;
+    std::unique_ptr<Arguments> args;
+    std::unique_ptr<Scene> scene;
+    RenderContextStats stats;
+    // the counters of RenderStats when the render began
+    RenderStats statsStart;
+    std::chrono::steady_clock::time_point start;
+
+    ///@return false if cancelled
+    bool renderColor(Image &img, std::function<void(double)> onProgress, const CancellationToken *token);
+    void beginStats();
+    void endStats(bool done);
+};
+
+#endif // RENDERCONTEXT_H
@@ -0,0 +1,254 @@
+#include "Server.h"
+#include "Entry.h"
+#include "data/Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+///@return the modification time of the file at path, 0 if there is none
+static time_t modificationTime(const string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+///@brief reads the files from disk and records the modification time of
+/// every path a scene opens, also of the missing ones
+class RecordingResourceProvider : public ResourceProvider {
+public:
+    virtual bool open(const string &path, Resource &resource) const {
+        mtimes[path] = modificationTime(path);
+        return ResourceProvider::files().open(path, resource);
+    }
+
+    mutable map<string, time_t> mtimes;
+};
+
+///@brief loaded scenes by path, a scene is parsed again (and its octrees
+/// rebuilt) only when its file or one it loads (meshes, textures, cube
+/// maps) has been modified, created or deleted
+class SceneCache {
+public:
+    ///@param error set to why the scene could not be loaded
+    ///@return NULL if path is not a readable, well formed scene file
+    Scene *get(const string &path, string &error) {
+        if (path.size() < 4 || path.compare(path.size() - 4, 4, ".txt") != 0 || modificationTime(path) == 0) {
+            error = "cannot open scene file " + path;
+            return NULL;
+        }
+        auto &cached = scenes[path];
+        if (cached.scene == NULL || cached.modified()) {
+            // free the old scene before loading the new one
+            cached.scene.reset();
+            RecordingResourceProvider files;
+            auto scene = make_unique<Scene>(path.c_str(), files);
+            if (!scene->getError().empty()) {
+                error = scene->getError();
+                scenes.erase(path);
+                return NULL;
+            }
+            cached.scene = std::move(scene);
+            cached.mtimes = files.mtimes;
+        }
+        return cached.scene.get();
+    }
+
+private:
+    struct Cached {
+        map<string, time_t> mtimes;
+        unique_ptr<Scene> scene;
+
+        bool modified() const {
+            for (const auto &[path, mtime] : mtimes) {
+                if (modificationTime(path) != mtime) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+    map<string, Cached> scenes;
+};
+
+///@brief what to do after a job
+enum JobOutcome {
+    NEXT_JOB,
+    // the client has gone away, its connection is closed
+    DROP_CLIENT,
+    STOP_SERVER
+};
+
+///@return false if the reader has gone away (EPIPE, SIGPIPE is ignored)
+/// or the write failed otherwise
+static bool writeAll(int fd, const char *buf, size_t n) {
+    while (n > 0) {
+        ssize_t written = write(fd, buf, n);
+        if (written <= 0) {
+            return false;
+        }
+        buf += written;
+        n -= written;
+    }
+    return true;
+}
+
+static bool writeLine(int fd, const string &line) {
+    return writeAll(fd, (line + "\n").c_str(), line.size() + 1);
+}
+
+static bool sendImage(int fd, const char *filename) {
+    ifstream file(filename, ios::binary);
+    string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    return writeLine(fd, "image " + string(filename) + " " + to_string(content.size())) &&
+           writeAll(fd, content.data(), content.size());
+}
+
+///@param out where replies are written, replies are only printed if < 0
+///@param inputFile scene of the jobs without -input
+static JobOutcome runJob(const string &line, SceneCache &cache, int out, const CancellationToken *token,
+                         const char *inputFile = NULL) {
+    istringstream in(line);
+    vector<string> tokens{"proj"};
+    for (string t; in >> t;) {
+        tokens.push_back(t);
+    }
+    if (tokens.size() == 1 || tokens[1][0] == '#') {
+        return NEXT_JOB;
+    }
+    if (tokens[1] == "quit") {
+        return STOP_SERVER;
+    }
+    if (inputFile != NULL && find(tokens.begin(), tokens.end(), "-input") == tokens.end()) {
+        tokens.push_back("-input");
+        tokens.push_back(inputFile);
+    }
+    auto reply = [out](const string &line) {
+        if (out < 0) {
+            cout << line << endl;
+            return NEXT_JOB;
+        }
+        return writeLine(out, line) ? NEXT_JOB : DROP_CLIENT;
+    };
+    vector<const char *> argv;
+    for (auto &t : tokens) {
+        argv.push_back(t.c_str());
+    }
+    // a malformed job is answered with an error, the server goes on
+    Arguments args;
+    string error;
+    if (!args.parse(argv.size(), argv.data(), error)) {
+        return reply("error " + error);
+    }
+    if (args.inputFile == NULL) {
+        return reply("error expecting -input [inputFile]");
+    }
+    Scene *scene = cache.get(args.inputFile, error);
+    if (scene == NULL) {
+        return reply("error " + error);
+    }
+
+    using namespace std::chrono;
+    auto t0 = steady_clock::now();
+    auto result = entry(args, *scene, [](double) {}, nullptr, token);
+    auto ms = duration_cast<milliseconds>(steady_clock::now() - t0).count();
+    if (!result.error.empty()) {
+        return reply("error " + result.error);
+    }
+    vector<const char *> files{args.outputFile};
+    files.insert(files.end(), begin(args.aovFiles), end(args.aovFiles));
+    for (const char *file : files) {
+        if (file != NULL && out >= 0 && !sendImage(out, file)) {
+            return DROP_CLIENT;
+        }
+    }
+    if (reply((result.cancelled ? "cancelled " : "done ") + to_string(ms)) == DROP_CLIENT) {
+        return DROP_CLIENT;
+    }
+    return token != NULL && token->isCancelled() ? STOP_SERVER : NEXT_JOB;
+}
+
+///@brief runs the jobs read from in until the end of input, or until the
+/// client goes away
+///@return false if the server should stop
+static bool runJobs(int in, int out, SceneCache &cache, const CancellationToken *token) {
+    FILE *file = fdopen(in, "r");
+    char *line = NULL;
+    size_t size = 0;
+    JobOutcome outcome = NEXT_JOB;
+    while (outcome == NEXT_JOB && getline(&line, &size, file) >= 0) {
+        outcome = runJob(line, cache, out, token);
+    }
+    free(line);
+    fclose(file);
+    return outcome != STOP_SERVER && (token == NULL || !token->isCancelled());
+}
+
+int runJobFile(const Arguments &args, const CancellationToken *token) {
+    ifstream file(args.jobsFile);
+    if (!file) {
+        cout << "cannot open job file " << args.jobsFile << endl;
+        return 1;
+    }
+    SceneCache cache;
+    string line;
+    while (getline(file, line) && runJob(line, cache, -1, token, args.inputFile) == NEXT_JOB) {
+    }
+    return token != NULL && token->isCancelled() ? 130 : 0;
+}
+
+int serve(const Arguments &args, const CancellationToken *token) {
+    // a client that goes away fails the writes to it with EPIPE, which
+    // drops the client instead of killing the server
+    signal(SIGPIPE, SIG_IGN);
+    SceneCache cache;
+    if (args.socketFile == NULL) {
+        // stdout carries the replies, everything the renderer prints goes
+        // to stderr instead
+        cout.flush();
+        fflush(stdout);
+        int out = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        runJobs(STDIN_FILENO, out, cache, token);
+        close(out);
+        return 0;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, args.socketFile, sizeof(addr.sun_path) - 1);
+    unlink(args.socketFile);
+    if (server < 0 || bind(server, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 4) != 0) {
+        perror("cannot listen on socket");
+        return 1;
+    }
+    cout << "Listening on " << args.socketFile << endl;
+    // clients are served one at a time, they share the scene cache
+    bool running = true;
+    while (running) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) {
+            break;
+        }
+        running = runJobs(dup(client), client, cache, token);
+        close(client);
+    }
+    close(server);
+    unlink(args.socketFile);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "render/Arguments.h"
+#include "render/Cancellation.h"
+
+///@brief reads render jobs, one per line in the command line vocabulary
+/// (e.g. "-input scene.txt -size 200 200 -output out.bmp -casting"),
+/// from stdin or from the clients of the Unix socket args.socketFile,
+/// and renders them against scenes kept loaded between jobs
+///
+/// every image a job writes is sent back as a line "image <file> <bytes>"
+/// followed by the file content, then the job ends with a line
+/// "done <ms>", "cancelled <ms>" or "error <message>", the latter for
+/// malformed jobs and scenes; a line "quit" stops the server, a client
+/// that goes away only ends its connection
+///@param token cancels the job in progress and stops the server
+int serve(const Arguments &args, const CancellationToken *token);
+
+///@brief renders the jobs of args.jobsFile, one per line in the same
+/// vocabulary as the server, jobs without -input use args.inputFile;
+/// every scene is loaded once for all the jobs that use it
+int runJobFile(const Arguments &args, const CancellationToken *token);
+
+#endif // SERVER_H
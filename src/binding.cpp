@@ -3,7 +3,10 @@
 #include <emscripten/bind.h>
 
 #include "Entry.h"
+#include "RenderContext.h"
+#include "data/Resource.h"
 #include "render/Arguments.h"
+#include "render/Image.h"
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -11,6 +14,59 @@
 
 using namespace emscripten;
 
+// the files pushed by the front end, such as the text of the scene
+// editor, read by the renders instead of those of the file system
+MemoryResourceProvider resources(&ResourceProvider::files());
+
+// the scene of the last render, kept loaded for the next ones until
+// another scene is asked for or the resources change
+RenderContext context;
+std::string loadedScene;
+
+///@brief loads the scene of the options of context, unless it is the
+/// one loaded
+///@return false if it cannot be opened, error then says why
+bool loadScene(std::string &error) {
+    const char *input = context.getArguments().inputFile;
+    if (input == NULL) {
+        error = "expecting -input [inputFile]";
+        return false;
+    }
+    if (context.isLoaded() && loadedScene == input) {
+        return true;
+    }
+    loadedScene.clear();
+    if (!context.load(input, resources, &error)) {
+        return false;
+    }
+    loadedScene = input;
+    return true;
+}
+
+///@brief serves contents, a string or the bytes of a typed array, as
+/// the file at path to the next renders; exec loads the scene before it
+/// yields to the browser, so a render in progress keeps the old one
+void setResource(std::string path, std::string contents) {
+    resources.add(path, std::move(contents));
+    loadedScene.clear();
+}
+
+///@brief goes back to the file of the file system at path
+void removeResource(std::string path) {
+    resources.remove(path);
+    loadedScene.clear();
+}
+
+///@return the text set for path, or null if it is read from the file
+/// system
+val getResource(std::string path) {
+    Resource file;
+    if (!resources.contains(path) || !resources.open(path, file)) {
+        return val::null();
+    }
+    return val(std::string(file.data));
+}
+
 inline val progressEvent(double percentage) {
     val res = val::object();
     res.set("type", 0);
@@ -18,39 +74,65 @@ inline val progressEvent(double percentage) {
     return res;
 }
 
+inline val passEvent(int spp) {
+    val res = val::object();
+    res.set("type", 1);
+    res.set("spp", spp);
+    return res;
+}
+
 std::string exec(std::vector<std::string> argvec, val callback, double callbackFreq) {
-    int argc = argvec.size() + 1;
-    const char **argv = new const char *[argc];
-    for (size_t i = 1; i < argc; ++i) {
-        argv[i] = argvec[i - 1].c_str();
+    std::string error;
+    if (!context.setOptions(argvec, error)) {
+        std::cout << error << std::endl;
+        return "";
+    }
+    const Arguments &args = context.getArguments();
+    std::string input = args.inputFile != NULL ? args.inputFile : "";
+    if (!loadScene(error)) {
+        std::cout << error << std::endl;
+        return input;
     }
-
-    Arguments args(argc, argv);
 
     using namespace std::chrono;
     auto t0 = duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-    auto onProgress = [&callback, &t0, callbackFreq](double p) {
+    // a stop from the front end cancels the render, the partial image is
+    // still written to the output file
+    CancellationToken token;
+    auto onProgress = [&callback, &t0, &token, callbackFreq](double p) {
         auto t1 = duration_cast<milliseconds>(system_clock::now().time_since_epoch());
         if ((t1 - t0).count() * callbackFreq > 1000) {
             t0 = t1;
             int stop = callback(progressEvent(p)).as<int>();
             if (stop) {
-                exit(0);
+                token.cancel();
             }
             emscripten_sleep(0);
         }
     };
 
-    entry(args, onProgress);
+    // progressive passes are written to the output file, so that the
+    // front end can show them before the render completes
+    auto onPass = [&callback, &args, &token](const Image &img, int spp) {
+        img.saveImage(args.outputFile);
+        int stop = callback(passEvent(spp)).as<int>();
+        if (stop) {
+            token.cancel();
+        }
+        emscripten_sleep(0);
+    };
 
-    delete[] argv;
+    context.renderFiles(onProgress, onPass, &token);
 
-    return args.inputFile;
+    return input;
 }
 
 EMSCRIPTEN_BINDINGS(my_module) {
     register_vector<std::string>("StringVector");
-    function("exec", &exec);
+    emscripten::function("exec", &exec);
+    emscripten::function("setResource", &setResource);
+    emscripten::function("removeResource", &removeResource);
+    emscripten::function("getResource", &getResource);
 }
 
 #endif
\ No newline at end of file
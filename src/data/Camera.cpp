@@ -7,15 +7,64 @@ Ray PerspectiveCamera::generateRay(const Vector2f &point) const {
     return Ray(center, r);
 }
 
+bool PerspectiveCamera::project(const Vector3f &p, Vector2f &point) const {
+    Vector3f d = p - center;
+    float z = Vector3f::dot(d, w);
+    if (z <= 0) {
+        return false;
+    }
+    float D = 1.0f / tan(angle / 2);
+    point = Vector2f(Vector3f::dot(d, u) * D / z, Vector3f::dot(d, v) * D / (aspect * z));
+    return true;
+}
+
+///@brief Shirley and Chiu's mapping of the unit square to the unit disk,
+/// which keeps the strata of the square compact on the disk
+static Vector2f concentricDisk(const Vector2f &s) {
+    float a = 2 * s[0] - 1, b = 2 * s[1] - 1;
+    if (a == 0 && b == 0) {
+        return Vector2f(0, 0);
+    }
+    float r, phi;
+    if (fabs(a) > fabs(b)) {
+        r = a;
+        phi = M_PI / 4 * (b / a);
+    } else {
+        r = b;
+        phi = M_PI / 2 - M_PI / 4 * (a / b);
+    }
+    return Vector2f(r * cos(phi), r * sin(phi));
+}
+
 Ray ThinLensCamera::generateRay(const Vector2f &point) const {
+    return generateRay(point, Vector2f(0.5, 0.5));
+}
+
+Ray ThinLensCamera::generateRay(const Vector2f &point, std::minstd_rand &rng) const {
+    std::uniform_real_distribution<float> unit(0, 1);
+    float x = unit(rng), y = unit(rng);
+    return generateRay(point, Vector2f(x, y));
+}
+
+Ray ThinLensCamera::generateRay(const Vector2f &point, const Vector2f &lens) const {
     float D = 1.0 / tan(angle / 2.0);
     Vector3f originalDir = (point[0] * u + point[1] * v + w * D).normalized();
     Vector3f focal_pt = center + focus_dist * originalDir;
-    float x = (((float)rand() / RAND_MAX) * 1) - 0.5;
-    float y = (((float)rand() / RAND_MAX) * 1) - 0.5;
-    Vector3f offset(x * aperture, y * aperture, 0);
-    Vector3f newCenter = center + offset;
-    Vector3f len_r = focal_pt - newCenter;
-    len_r.normalized();
+    // aperture is the diameter of the lens
+    Vector2f disk = 0.5f * aperture * concentricDisk(lens);
+    Vector3f newCenter = center + disk[0] * u + disk[1] * v;
+    Vector3f len_r = (focal_pt - newCenter).normalized();
     return Ray(newCenter, len_r);
 }
+
+float ThinLensCamera::circleOfConfusion(float distance) const {
+    float D = 1.0 / tan(angle / 2.0);
+    // the rays through the lens cross at focus_dist, at distance they
+    // spread over a disk of radius r * |distance - focus_dist| / focus_dist,
+    // which the screen sees shrunk by D / distance
+    float r = 0.5f * aperture;
+    if (std::isinf(distance)) {
+        return r * D / focus_dist;
+    }
+    return r * fabs(distance - focus_dist) / focus_dist * D / distance;
+}
@@ -2,13 +2,27 @@
 #define CAMERA_H
 
 #include "Ray.h"
+#include <random>
 #include <vecmath.h>
 
 class Camera {
 public:
     // generate rays for each screen-space coordinate
     virtual Ray generateRay(const Vector2f &point) const = 0;
+    ///@brief the same with the random numbers a camera with a lens draws
+    /// its point of the lens from, one generator per rendering thread
+    virtual Ray generateRay(const Vector2f &point, __attribute__((unused)) std::minstd_rand &rng) const {
+        return generateRay(point);
+    }
     virtual float getTMin() const = 0;
+    ///@brief screen-space coordinate whose ray goes through p, the
+    /// inverse of generateRay
+    ///@return false if p is behind the camera, or the camera has no
+    /// one-to-one projection
+    virtual bool project(__attribute__((unused)) const Vector3f &p,
+                         __attribute__((unused)) Vector2f &point) const {
+        return false;
+    }
     virtual ~Camera() {}
 
 protected:
@@ -31,6 +45,7 @@ public:
     float getTMin() const {
         return 0.0f;
     }
+    bool project(const Vector3f &p, Vector2f &point) const;
 
 private:
     float aspect = 1;
@@ -52,10 +67,21 @@ public:
           v(Vector3f::cross(u, w).normalized()),
           focus_dist(focus_dist),
           aperture(aperture) {}
+    ///@brief ray through the center of the lens
     Ray generateRay(const Vector2f &point) const;
+    ///@brief ray through a random point of the lens
+    Ray generateRay(const Vector2f &point, std::minstd_rand &rng) const;
+    ///@brief ray through the point of the lens given by lens in [0, 1)^2,
+    /// mapped to the aperture disk with the concentric mapping, so that
+    /// stratified samples stay stratified on the disk; (0.5, 0.5) is the
+    /// center of the lens
+    Ray generateRay(const Vector2f &point, const Vector2f &lens) const;
     float getTMin() const {
         return 0.0f;
     }
+    ///@brief radius, in screen-space units, of the circle of confusion of
+    /// a point at distance along a ray through the center of the lens
+    float circleOfConfusion(float distance) const;
 
 private:
     float aspect = 1;
@@ -3,14 +3,14 @@
 
 using namespace std;
 
-CubeMap::CubeMap(const char *directory) {
+CubeMap::CubeMap(const char *directory, const ResourceProvider &resources) {
     string suffix[6] = {"left", "right", "up", "down", "front", "back"};
     string dirname(directory);
     for (int ii = 0; ii < 6; ii++) {
         string filename = dirname + "/";
         filename = filename + suffix[ii];
         filename = filename + ".bmp";
-        t[ii].load(filename.c_str());
+        t[ii].load(filename.c_str(), resources);
     }
 }
 
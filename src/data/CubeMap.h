@@ -7,8 +7,8 @@
 class CubeMap {
 public:
     ///@brief assumes a directory containing
-    /// [left, right, up, down, front, back].bmp
-    CubeMap(const char *dir);
+    /// [left, right, up, down, front, back].bmp, read from resources
+    CubeMap(const char *dir, const ResourceProvider &resources = ResourceProvider::files());
     enum FACE {
         LEFT,
         RIGHT,
@@ -15,6 +15,8 @@ public:
     bool casting = false;
     bool hasTbn = false;
     Matrix3f tbn;
+    ///@brief index of the top-level object of the scene group that was hit
+    int objectIndex = -1;
 
     Hit() {}
     Hit(bool casting) : casting(casting) {}
@@ -23,7 +25,7 @@ public:
         set(t, m, n);
     }
     Hit(const Hit &h)
-        : hasTex(h.hasTex), t(h.t), material(h.material), normal(h.normal) {}
+        : hasTex(h.hasTex), objectIndex(h.objectIndex), t(h.t), material(h.material), normal(h.normal) {}
     ~Hit() {}
 
     float getT() const {
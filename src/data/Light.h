@@ -32,6 +32,16 @@ public:
     ~PointLight() {}
     virtual void getIllumination(const Vector3f &p, Vector3f &dir, Vector3f &col, float &distanceToLight) const;
 
+    const Vector3f &getPosition() const {
+        return position;
+    }
+    const Vector3f &getColor() const {
+        return color;
+    }
+    float getFalloff() const {
+        return falloff;
+    }
+
 private:
     Vector3f position;
     Vector3f color;
@@ -0,0 +1,120 @@
+#include "LightTree.h"
+#include <algorithm>
+
+static float maxComponent(const Vector3f &v) {
+    return std::max(v[0], std::max(v[1], v[2]));
+}
+
+///@brief squared distance from p to the closest point of b
+static float boxDistanceSquared(const Box &b, const Vector3f &p) {
+    float d2 = 0;
+    for (int dim = 0; dim < 3; dim++) {
+        float d = std::max(0.0f, std::max(b.mn[dim] - p[dim], p[dim] - b.mx[dim]));
+        d2 += d * d;
+    }
+    return d2;
+}
+
+void LightTree::build(Light **lights, int numLights) {
+    nodes.clear();
+    std::vector<Item> items;
+    for (int i = 0; i < numLights; i++) {
+        auto pointLight = dynamic_cast<const PointLight *>(lights[i]);
+        if (pointLight != NULL) {
+            items.push_back({i, pointLight});
+        }
+    }
+    if (items.empty()) {
+        return;
+    }
+    nodes.reserve(2 * items.size() - 1);
+    buildNode(items, 0, items.size());
+}
+
+///@brief splits at the median of the longest axis of the light positions
+int LightTree::buildNode(std::vector<Item> &items, int begin, int end) {
+    int idx = nodes.size();
+    nodes.emplace_back();
+    LightNode node;
+    const Vector3f &p0 = items[begin].pointLight->getPosition();
+    node.box = Box(p0, p0);
+    node.intensity = 0;
+    node.falloff = items[begin].pointLight->getFalloff();
+    for (int i = begin; i < end; i++) {
+        auto light = items[i].pointLight;
+        for (int dim = 0; dim < 3; dim++) {
+            node.box.mn[dim] = std::min(node.box.mn[dim], light->getPosition()[dim]);
+            node.box.mx[dim] = std::max(node.box.mx[dim], light->getPosition()[dim]);
+        }
+        node.intensity += maxComponent(light->getColor());
+        node.falloff = std::min(node.falloff, light->getFalloff());
+    }
+    if (end - begin == 1) {
+        node.light = items[begin].light;
+    } else {
+        Vector3f extent = node.box.mx - node.box.mn;
+        int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2)
+                                         : (extent[1] > extent[2] ? 1 : 2);
+        int mid = (begin + end) / 2;
+        std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                         [axis](const Item &a, const Item &b) {
+                             return a.pointLight->getPosition()[axis] < b.pointLight->getPosition()[axis];
+                         });
+        node.child[0] = buildNode(items, begin, mid);
+        node.child[1] = buildNode(items, mid, end);
+    }
+    nodes[idx] = node;
+    return idx;
+}
+
+float LightTree::importance(const LightNode &node, const Vector3f &p) const {
+    // same attenuation as PointLight::getIllumination, taken at the
+    // closest point of the node so that it never underestimates
+    return node.intensity / (1 + node.falloff * boxDistanceSquared(node.box, p));
+}
+
+void LightTree::cull(const Vector3f &p, float threshold, std::vector<LightSelection> &out) const {
+    if (nodes.empty()) {
+        return;
+    }
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const LightNode &node = nodes[stack[--top]];
+        if (importance(node, p) < threshold) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            out.push_back({node.light, 1});
+        } else {
+            stack[top++] = node.child[0];
+            stack[top++] = node.child[1];
+        }
+    }
+}
+
+void LightTree::sample(const Vector3f &p, int n, std::minstd_rand &rng, std::vector<LightSelection> &out) const {
+    if (nodes.empty()) {
+        return;
+    }
+    std::uniform_real_distribution<float> unit(0, 1);
+    for (int k = 0; k < n; k++) {
+        const LightNode *node = &nodes[0];
+        float pdf = 1;
+        while (!node->isLeaf()) {
+            const LightNode &l = nodes[node->child[0]];
+            const LightNode &r = nodes[node->child[1]];
+            float il = importance(l, p), ir = importance(r, p);
+            float pl = il + ir > 0 ? il / (il + ir) : 0.5f;
+            if (unit(rng) < pl) {
+                node = &l;
+                pdf *= pl;
+            } else {
+                node = &r;
+                pdf *= 1 - pl;
+            }
+        }
+        out.push_back({node->light, 1 / (n * pdf)});
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef LIGHTTREE_H
+#define LIGHTTREE_H
+
+#include "Light.h"
+#include "Octree.h"
+#include <random>
+#include <vector>
+
+///@brief a light picked for shading, its color is scaled by weight
+struct LightSelection {
+    int light;
+    float weight;
+};
+
+struct LightNode {
+    ///@brief bounds of the light positions below this node
+    Box box;
+    ///@brief summed max color component of the lights below
+    float intensity;
+    ///@brief smallest falloff below, gives an upper bound of attenuation
+    float falloff;
+    int child[2] = {-1, -1};
+    ///@brief light index for leaves
+    int light = -1;
+    bool isLeaf() const { return child[0] < 0; }
+};
+
+///@brief binary hierarchy over the point lights of a scene, used to
+/// cull or importance sample lights when there are many of them
+class LightTree {
+public:
+    void build(Light **lights, int numLights);
+    bool empty() const { return nodes.empty(); }
+
+    ///@brief appends every light whose attenuated contribution at p
+    /// may reach threshold, with weight 1
+    void cull(const Vector3f &p, float threshold, std::vector<LightSelection> &out) const;
+    ///@brief appends n lights drawn by estimated contribution at p,
+    /// weighted by 1 / (n * pdf) so that the estimate stays unbiased
+    void sample(const Vector3f &p, int n, std::minstd_rand &rng, std::vector<LightSelection> &out) const;
+
+private:
+    struct Item {
+        int light;
+        const PointLight *pointLight;
+    };
+    std::vector<LightNode> nodes;
+
+    int buildNode(std::vector<Item> &items, int begin, int end);
+    ///@brief upper bound of the contribution of node at p
+    float importance(const LightNode &node, const Vector3f &p) const;
+};
+
+#endif // LIGHTTREE_H
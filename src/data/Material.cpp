@@ -1,8 +1,10 @@
 #include "Material.h"
+#include "../render/Stats.h"
 
 Vector3f Material::getShadingColor(const Ray &ray, const Hit &hit,
                                    const Vector3f &dirToLight, const Vector3f &lightColor,
                                    bool pixelated, bool rayCasting) const {
+    STAT_SHADE(this);
     bool useNormalMap = normalMap.valid() && hit.hasTex && hit.hasTbn;
     Vector3f n = hit.getNormal();
     if (useNormalMap) {
@@ -27,8 +29,12 @@ Vector3f Material::getShadingColor(const Ray &ray, const Hit &hit,
 }
 
 Vector3f Material::getEnvironmentColor(const Ray &ray, const Hit &hit) const {
+    STAT_SHADE(this);
     auto N = hit.getNormal();
     auto d = ray.getDirection();
     auto reflection =  d - 2 * Vector3f::dot(d, N) * N;
-    return 0.5 * cubemap->operator()(reflection) + 0.5 * noise.getColor(ray.getOrigin() + ray.getDirection() * hit.getT());
+    auto baseColor = noise.inited
+                         ? noise.getColor(ray.getOrigin() + ray.getDirection() * hit.getT())
+                         : diffuseColor;
+    return 0.5 * cubemap->operator()(reflection) + 0.5 * baseColor;
 }
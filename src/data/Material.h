@@ -28,11 +28,11 @@ public:
                              bool pixelated, bool rayCasting = false) const;
     Vector3f getEnvironmentColor(const Ray &ray, const Hit &hit) const;
 
-    void loadTexture(const char *filename) {
-        t.load(filename);
+    void loadTexture(const char *filename, const ResourceProvider &resources = ResourceProvider::files()) {
+        t.load(filename, resources);
     }
-    void loadNormalMap(const char *filename) {
-        normalMap.load(filename);
+    void loadNormalMap(const char *filename, const ResourceProvider &resources = ResourceProvider::files()) {
+        normalMap.load(filename, resources);
     }
     void setNoise(const Noise &n) {
         noise = n;
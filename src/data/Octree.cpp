@@ -1,9 +1,11 @@
 #include "Octree.h"
 #include "../object3d/Mesh.h"
+#include "../render/Stats.h"
+#include "../render/Trace.h"
 #include <algorithm>
 
 ///@brief two intervals intersect
-bool intersect(float *a, float *b) {
+static bool intersect(float *a, float *b) {
     if (a[0] > b[1]) {
         float *tmp = a;
         a = b;
@@ -13,7 +15,7 @@ bool intersect(float *a, float *b) {
 }
 
 ///@brief two boxes intersect
-bool boxOverlap(Box *a, Box *b) {
+static bool boxOverlap(Box *a, Box *b) {
     for (int dim = 0; dim < 3; dim++) {
         float ia[2] = {a->mn[dim], a->mx[dim]};
         float ib[2] = {b->mn[dim], b->mx[dim]};
@@ -24,7 +26,7 @@ bool boxOverlap(Box *a, Box *b) {
     }
     return true;
 }
-bool inside(const Box &a, const Box &b) {
+static bool inside(const Box &a, const Box &b) {
     for (int dim = 0; dim < 3; dim++) {
         if (a.mn[dim] < b.mn[dim] || a.mx[dim] > b.mx[dim]) {
             return false;
@@ -33,7 +35,7 @@ bool inside(const Box &a, const Box &b) {
     return true;
 }
 ///@brief bounding box for a triangle
-Box trigBox(int t, const Mesh &m) {
+static Box trigBox(int t, const Mesh &m) {
     Box b;
     b.mn = m.v[m.t[t][0]];
     b.mx = m.v[m.t[t][0]];
@@ -99,6 +101,7 @@ void Octree::buildNode(OctNode &parent, const Box &pbox,
 }
 
 void Octree::build(const Mesh &m) {
+    TRACE_SCOPE("build octree");
     /// compute bounding box for m
     box.mn = m.v[0];
     box.mx = m.v[0];
@@ -120,7 +123,7 @@ void Octree::build(const Mesh &m) {
     buildNode(root, box, trigs, m, 0);
 }
 
-int first_node(float tx0, float ty0, float tz0, float txm, float tym, float tzm) {
+static int first_node(float tx0, float ty0, float tz0, float txm, float tym, float tzm) {
     char bits = 0;
     /// find max x0 y0 z0
     if (tx0 > ty0) {
@@ -153,7 +156,7 @@ int first_node(float tx0, float ty0, float tz0, float txm, float tym, float tzm)
     return bits;
 }
 
-int new_node(float txm, int x, float tym, int y, float tzm, int z) {
+static int new_node(float txm, int x, float tym, int y, float tzm, int z) {
     if (txm < tym) {
         if (txm < tzm) {
             return x;
@@ -166,9 +169,11 @@ int new_node(float txm, int x, float tym, int y, float tzm, int z) {
     return z;
 }
 
-void Octree::proc_subtree(float tx0, float ty0, float tz0, float tx1, float ty1, float tz1, OctNode *node) {
+void Octree::proc_subtree(float tx0, float ty0, float tz0, float tx1, float ty1, float tz1, const OctNode *node,
+                          unsigned char aa, void (*termFunc)(int idx, void **arg), void **arg) const {
     float txm, tym, tzm;
     int currNode;
+    STAT_INC(STAT_OCTREE_NODES);
     if (tx1 < 0 || ty1 < 0 || tz1 < 0) {
         return;
     }
@@ -186,42 +191,42 @@ void Octree::proc_subtree(float tx0, float ty0, float tz0, float tx1, float ty1,
     do {
         switch (currNode) {
         case 0: {
-            proc_subtree(tx0, ty0, tz0, txm, tym, tzm, node->child[aa]);
+            proc_subtree(tx0, ty0, tz0, txm, tym, tzm, node->child[aa], aa, termFunc, arg);
             currNode = new_node(txm, 4, tym, 2, tzm, 1);
             break;
         }
         case 1: {
-            proc_subtree(tx0, ty0, tzm, txm, tym, tz1, node->child[1 ^ aa]);
+            proc_subtree(tx0, ty0, tzm, txm, tym, tz1, node->child[1 ^ aa], aa, termFunc, arg);
             currNode = new_node(txm, 5, tym, 3, tz1, 8);
             break;
         }
         case 2: {
-            proc_subtree(tx0, tym, tz0, txm, ty1, tzm, node->child[2 ^ aa]);
+            proc_subtree(tx0, tym, tz0, txm, ty1, tzm, node->child[2 ^ aa], aa, termFunc, arg);
             currNode = new_node(txm, 6, ty1, 8, tzm, 3);
             break;
         }
         case 3: {
-            proc_subtree(tx0, tym, tzm, txm, ty1, tz1, node->child[3 ^ aa]);
+            proc_subtree(tx0, tym, tzm, txm, ty1, tz1, node->child[3 ^ aa], aa, termFunc, arg);
             currNode = new_node(txm, 7, ty1, 8, tz1, 8);
             break;
         }
         case 4: {
-            proc_subtree(txm, ty0, tz0, tx1, tym, tzm, node->child[4 ^ aa]);
+            proc_subtree(txm, ty0, tz0, tx1, tym, tzm, node->child[4 ^ aa], aa, termFunc, arg);
             currNode = new_node(tx1, 8, tym, 6, tzm, 5);
             break;
         }
         case 5: {
-            proc_subtree(txm, ty0, tzm, tx1, tym, tz1, node->child[5 ^ aa]);
+            proc_subtree(txm, ty0, tzm, tx1, tym, tz1, node->child[5 ^ aa], aa, termFunc, arg);
             currNode = new_node(tx1, 8, tym, 7, tz1, 8);
             break;
         }
         case 6: {
-            proc_subtree(txm, tym, tz0, tx1, ty1, tzm, node->child[6 ^ aa]);
+            proc_subtree(txm, tym, tz0, tx1, ty1, tzm, node->child[6 ^ aa], aa, termFunc, arg);
             currNode = new_node(tx1, 8, ty1, 8, tzm, 7);
             break;
         }
         case 7: {
-            proc_subtree(txm, tym, tzm, tx1, ty1, tz1, node->child[7 ^ aa]);
+            proc_subtree(txm, tym, tzm, tx1, ty1, tz1, node->child[7 ^ aa], aa, termFunc, arg);
             currNode = 8;
             break;
         }
@@ -229,12 +234,12 @@ void Octree::proc_subtree(float tx0, float ty0, float tz0, float tx1, float ty1,
     } while (currNode < 8);
 }
 
-void Octree::intersect(const Ray &ray) {
+void Octree::intersect(const Ray &ray, void (*termFunc)(int idx, void **arg), void **arg) const {
     Vector3f rd = ray.getDirection();
     // assumes rd normalized
     rd.normalize();
     Vector3f ro = ray.getOrigin();
-    aa = 0;
+    unsigned char aa = 0;
     Vector3f size = box.mx + box.mn;
     if (rd[0] < 0.0f) {
         ro[0] = size[0] - ro[0];
@@ -264,6 +269,6 @@ void Octree::intersect(const Ray &ray) {
     float tz1 = (box.mx[2] - ro[2]) * divz;
 
     if (max(max(tx0, ty0), tz0) <= min(min(tx1, ty1), tz1)) {
-        proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root);
+        proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root, aa, termFunc, arg);
     }
 }
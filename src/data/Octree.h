@@ -20,7 +20,7 @@ struct OctNode {
         child[0] = 0;
     }
     ///@brief is this terminal
-    bool isTerm() { return child[0] == 0; }
+    bool isTerm() const { return child[0] == 0; }
     std::vector<int> obj;
 };
 class Mesh;
@@ -38,13 +38,15 @@ struct Octree {
                    const std::vector<int> &trigs,
                    const Mesh &m, int level);
 
-    ///@brief indexing
-    unsigned char aa;
-    void proc_subtree(float tx0, float ty0, float tz0, float tx1, float ty1, float tz1, OctNode *node);
-    void intersect(const Ray &ray);
+    ///@brief calls termFunc(idx, arg) on the triangles of the leaves
+    /// ray goes through; the walk keeps its state on the stack, so that
+    /// threads can walk the tree at once
+    void intersect(const Ray &ray, void (*termFunc)(int idx, void **arg), void **arg) const;
 
-    void **arg;
-    void (*termFunc)(int idx, void **arg);
+private:
+    ///@param aa indexing, the axes along which ray was mirrored
+    void proc_subtree(float tx0, float ty0, float tz0, float tx1, float ty1, float tz1, const OctNode *node,
+                      unsigned char aa, void (*termFunc)(int idx, void **arg), void **arg) const;
 };
 Octree buildOctree(const Mesh &m, int maxLevel = 7);
 
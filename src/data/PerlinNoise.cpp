@@ -5,15 +5,15 @@
 #include "PerlinNoise.h"
 #include <cmath>
 
-double fade(double t) {
+static double fade(double t) {
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
-double lerp(double t, double a, double b) {
+static double lerp(double t, double a, double b) {
     return a + t * (b - a);
 }
 
-double grad(int hash, double x, double y, double z) {
+static double grad(int hash, double x, double y, double z) {
     int h = hash & 15;        // CONVERT LO 4 BITS OF HASH CODE
     double u = h < 8 ? x : y; // INTO 12 GRADIENT DIRECTIONS.
     double v = h < 4 ? y : h == 12 || h == 14 ? x
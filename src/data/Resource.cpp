@@ -0,0 +1,68 @@
+#include "Resource.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+const ResourceProvider &ResourceProvider::files() {
+    static FileResourceProvider provider;
+    return provider;
+}
+
+bool FileResourceProvider::open(const string &path, Resource &resource) const {
+    ifstream f(path, ios::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+    resource.buffer.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+    resource.data = resource.buffer;
+    return true;
+}
+
+string MemoryResourceProvider::key(const string &path) {
+    return fs::absolute(fs::path(path)).lexically_normal().string();
+}
+
+void MemoryResourceProvider::add(const string &path, string contents) {
+    Entry &entry = entries[key(path)];
+    entry.contents = std::move(contents);
+    entry.data = NULL;
+    entry.size = 0;
+}
+
+void MemoryResourceProvider::addView(const string &path, const char *data, size_t size) {
+    Entry &entry = entries[key(path)];
+    entry.contents.clear();
+    entry.data = data;
+    entry.size = size;
+}
+
+void MemoryResourceProvider::remove(const string &path) {
+    entries.erase(key(path));
+}
+
+bool MemoryResourceProvider::contains(const string &path) const {
+    return entries.count(key(path)) > 0;
+}
+
+bool MemoryResourceProvider::open(const string &path, Resource &resource) const {
+    auto it = entries.find(key(path));
+    if (it == entries.end()) {
+        return fallback != NULL && fallback->open(path, resource);
+    }
+    const Entry &entry = it->second;
+    resource.buffer.clear();
+    if (entry.data != NULL) {
+        resource.data = string_view(entry.data, entry.size);
+    } else {
+        resource.data = entry.contents;
+    }
+    return true;
+}
+
+ResourceStream::ResourceStream(string_view data) : std::istream(NULL), buffer(data) {
+    rdbuf(&buffer);
+}
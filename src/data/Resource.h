@@ -0,0 +1,88 @@
+#ifndef RESOURCE_H
+#define RESOURCE_H
+
+#include <cstddef>
+#include <istream>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+///@brief the contents of a file, in buffer or in memory kept by the
+/// provider that opened it; data may point into buffer, so it is not
+/// copied
+struct Resource {
+    std::string_view data;
+    std::string buffer;
+};
+
+///@brief where a scene reads its files from: the scene text, and the
+/// meshes, textures and cube maps it names, by their paths relative to
+/// the scene joined to its directory
+class ResourceProvider {
+public:
+    virtual ~ResourceProvider() {}
+    ///@return false if there is no file at path
+    virtual bool open(const std::string &path, Resource &resource) const = 0;
+
+    ///@brief the files on disk, what the loaders read by default
+    static const ResourceProvider &files();
+};
+
+///@brief reads the files from disk
+class FileResourceProvider : public ResourceProvider {
+public:
+    virtual bool open(const std::string &path, Resource &resource) const;
+};
+
+///@brief serves buffers registered by path, such as the text of an
+/// editor or the blobs of a store, and passes the other paths on to
+/// fallback; paths are compared after making them absolute and normal,
+/// so scene/a.obj and ./scene/b/../a.obj are the same file
+///
+/// it is not synchronized, the files must not change while a scene loads
+class MemoryResourceProvider : public ResourceProvider {
+public:
+    explicit MemoryResourceProvider(const ResourceProvider *fallback = NULL) : fallback(fallback) {}
+
+    ///@brief serves a copy of contents as path
+    void add(const std::string &path, std::string contents);
+    ///@brief serves the size bytes at data as path without copying them,
+    /// they must stay valid until the path is removed or replaced
+    void addView(const std::string &path, const char *data, size_t size);
+    void remove(const std::string &path);
+    ///@return true if path was added, regardless of the fallback
+    bool contains(const std::string &path) const;
+
+    virtual bool open(const std::string &path, Resource &resource) const;
+
+private:
+    struct Entry {
+        std::string contents;
+        // the memory of the caller for views, NULL for copies
+        const char *data = NULL;
+        size_t size = 0;
+    };
+
+    static std::string key(const std::string &path);
+
+    const ResourceProvider *fallback;
+    std::map<std::string, Entry> entries;
+};
+
+///@brief reads the data of a resource in place, it must outlive the stream
+class ResourceStream : public std::istream {
+public:
+    explicit ResourceStream(std::string_view data);
+
+private:
+    struct Buffer : public std::streambuf {
+        Buffer(std::string_view data) {
+            char *begin = const_cast<char *>(data.data());
+            setg(begin, begin, begin + data.size());
+        }
+    };
+    Buffer buffer;
+};
+
+#endif // RESOURCE_H
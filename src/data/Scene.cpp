@@ -1,6 +1,8 @@
 #define _USE_MATH_DEFINES
 #include "Scene.h"
+#include "../render/Trace.h"
 #include <cmath>
+#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -9,22 +11,52 @@
 
 namespace fs = std::filesystem;
 
-SceneParser::SceneParser(Scene &scene, const char *filename) : scene(scene), filename(filename) {
+///@brief thrown by SceneParser::fail through the parse up to the Scene
+struct SceneError {
+    std::string message;
+};
+
+void SceneParser::fail(const char *format, ...) {
+    char message[256];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+    throw SceneError{std::string(filename) + ": " + message};
+}
+
+void SceneParser::expectToken(const char *expected) {
+    char token[MAX_PARSER_TOKEN_LENGTH];
+    getToken(token);
+    if (strcmp(token, expected) != 0) {
+        fail("expecting '%s' instead of '%s'", expected, token);
+    }
+}
+
+SceneParser::SceneParser(Scene &scene, const char *filename, const ResourceProvider &resources)
+    : scene(scene), filename(filename), resources(resources) {
     // parse the file
     assert(filename != NULL);
-    const char *ext = &filename[strlen(filename) - 4];
-
-    if (strcmp(ext, ".txt") != 0) {
-        printf("wrong file name extension\n");
-        exit(0);
+    size_t length = strlen(filename);
+    if (length < 4 || strcmp(filename + length - 4, ".txt") != 0) {
+        fail("wrong file name extension");
+    }
+    // the text is scanned in place, wherever resources keep it
+    Resource text;
+    file = NULL;
+    if (resources.open(filename, text)) {
+        file = fmemopen(const_cast<char *>(text.data.data()), text.data.size(), "r");
     }
-    file = fopen(filename, "r");
 
     if (file == NULL) {
-        printf("cannot open scene file\n");
-        exit(0);
+        fail("cannot open scene file");
+    }
+    try {
+        parseFile();
+    } catch (const SceneError &) {
+        fclose(file);
+        throw;
     }
-    parseFile();
     fclose(file);
     file = NULL;
 
@@ -58,8 +90,7 @@ void SceneParser::parseFile() {
         } else if (!strcmp(token, "Group")) {
             scene.group = parseGroup();
         } else {
-            printf("Unknown token in parseFile: '%s'\n", token);
-            exit(0);
+            fail("Unknown token in parseFile: '%s'", token);
         }
     }
 }
@@ -68,25 +99,18 @@ void SceneParser::parseFile() {
 // ====================================================================
 
 void SceneParser::parsePerspectiveCamera() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
     // read in the camera parameters
-    getToken(token);
-    assert(!strcmp(token, "{"));
-    getToken(token);
-    assert(!strcmp(token, "center"));
+    expectToken("{");
+    expectToken("center");
     scene.center = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "direction"));
+    expectToken("direction");
     scene.direction = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "up"));
+    expectToken("up");
     scene.up = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "angle"));
+    expectToken("angle");
     float angle_degrees = readFloat();
     scene.angle_radians = DegreesToRadians(angle_degrees);
-    getToken(token);
-    assert(!strcmp(token, "}"));
+    expectToken("}");
 
     scene.camera = new PerspectiveCamera(scene.center, scene.direction, scene.up, scene.angle_radians);
 }
@@ -94,8 +118,7 @@ void SceneParser::parsePerspectiveCamera() {
 void SceneParser::parseBackground() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     // read in the background color
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     while (1) {
         getToken(token);
         if (!strcmp(token, "}")) {
@@ -107,8 +130,7 @@ void SceneParser::parseBackground() {
         } else if (strcmp(token, "cubeMap") == 0) {
             scene.cubemap = parseCubeMap();
         } else {
-            printf("Unknown token in parseBackground: '%s'\n", token);
-            assert(0);
+            fail("Unknown token in parseBackground: '%s'", token);
         }
     }
 }
@@ -116,7 +138,7 @@ void SceneParser::parseBackground() {
 CubeMap *SceneParser::parseCubeMap() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     getToken(token);
-    return new CubeMap(getRelativePath(token).string().c_str());
+    return new CubeMap(getRelativePath(token).string().c_str(), resources);
 }
 
 // ====================================================================
@@ -124,13 +146,15 @@ CubeMap *SceneParser::parseCubeMap() {
 
 void SceneParser::parseLights() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     // read in the number of objects
-    getToken(token);
-    assert(!strcmp(token, "numLights"));
+    expectToken("numLights");
     scene.num_lights = readInt();
-    scene.lights = new Light *[scene.num_lights];
+    if (scene.num_lights < 0) {
+        fail("Negative numLights");
+    }
+    // null until parsed, so that a failed parse deletes only the lights read
+    scene.lights = new Light *[scene.num_lights]();
     // read in the objects
     int count = 0;
     while (scene.num_lights > count) {
@@ -140,35 +164,27 @@ void SceneParser::parseLights() {
         } else if (strcmp(token, "PointLight") == 0) {
             scene.lights[count] = parsePointLight();
         } else {
-            printf("Unknown token in parseLight: '%s'\n", token);
-            exit(0);
+            fail("Unknown token in parseLight: '%s'", token);
         }
         count++;
     }
-    getToken(token);
-    assert(!strcmp(token, "}"));
+    expectToken("}");
 }
 
 Light *SceneParser::parseDirectionalLight() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
-    getToken(token);
-    assert(!strcmp(token, "direction"));
+    expectToken("{");
+    expectToken("direction");
     Vector3f direction = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "color"));
+    expectToken("color");
     Vector3f color = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "}"));
+    expectToken("}");
     return new DirectionalLight(direction, color);
 }
 Light *SceneParser::parsePointLight() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     Vector3f position, color;
     float falloff = 0;
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     while (1) {
         getToken(token);
         if (strcmp(token, "position") == 0) {
@@ -178,7 +194,9 @@ Light *SceneParser::parsePointLight() {
         } else if (strcmp(token, "falloff") == 0) {
             falloff = readFloat();
         } else {
-            assert(!strcmp(token, "}"));
+            if (strcmp(token, "}") != 0) {
+                fail("Unknown token in parsePointLight: '%s'", token);
+            }
             break;
         }
     }
@@ -189,13 +207,14 @@ Light *SceneParser::parsePointLight() {
 
 void SceneParser::parseMaterials() {
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     // read in the number of objects
-    getToken(token);
-    assert(!strcmp(token, "numMaterials"));
+    expectToken("numMaterials");
     scene.num_materials = readInt();
-    scene.materials = new Material *[scene.num_materials];
+    if (scene.num_materials < 0) {
+        fail("Negative numMaterials");
+    }
+    scene.materials = new Material *[scene.num_materials]();
     // read in the objects
     int count = 0;
     while (scene.num_materials > count) {
@@ -204,13 +223,11 @@ void SceneParser::parseMaterials() {
             !strcmp(token, "PhongMaterial")) {
             scene.materials[count] = parseMaterial();
         } else {
-            printf("Unknown token in parseMaterial: '%s'\n", token);
-            exit(0);
+            fail("Unknown token in parseMaterial: '%s'", token);
         }
         count++;
     }
-    getToken(token);
-    assert(!strcmp(token, "}"));
+    expectToken("}");
 }
 
 Material *SceneParser::parseMaterial() {
@@ -223,8 +240,7 @@ Material *SceneParser::parseMaterial() {
     float shininess = 0;
     float refractionIndex = 0;
     CubeMap *cubemap = NULL;
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     Noise *noise = NULL;
     while (1) {
         getToken(token);
@@ -249,16 +265,18 @@ Material *SceneParser::parseMaterial() {
         } else if (strcmp(token, "Noise") == 0) {
             noise = parseNoise();
         } else {
-            assert(!strcmp(token, "}"));
+            if (strcmp(token, "}") != 0) {
+                fail("Unknown token in parseMaterial: '%s'", token);
+            }
             break;
         }
     }
     Material *answer = new Material(diffuseColor, specularColor, shininess, refractionIndex, cubemap);
     if (textureFileName[0] != 0) {
-        answer->loadTexture(getRelativePath(textureFileName).string().c_str());
+        answer->loadTexture(getRelativePath(textureFileName).string().c_str(), resources);
     }
     if (normalMapFileName[0] != 0) {
-        answer->loadNormalMap(getRelativePath(normalMapFileName).string().c_str());
+        answer->loadNormalMap(getRelativePath(normalMapFileName).string().c_str(), resources);
     }
     if (noise != NULL) {
         answer->setNoise(*noise);
@@ -274,8 +292,7 @@ Noise *SceneParser::parseNoise() {
     int octaves = 0;
     float frequency = 1;
     float amplitude = 1;
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     while (1) {
         getToken(token);
         if (strcmp(token, "color") == 0) {
@@ -292,7 +309,9 @@ Noise *SceneParser::parseNoise() {
         } else if (strcmp(token, "amplitude") == 0) {
             amplitude = readFloat();
         } else {
-            assert(!strcmp(token, "}"));
+            if (strcmp(token, "}") != 0) {
+                fail("Unknown token in parseNoise: '%s'", token);
+            }
             break;
         }
     }
@@ -317,8 +336,7 @@ Object3D *SceneParser::parseObject(char token[MAX_PARSER_TOKEN_LENGTH]) {
     } else if (!strcmp(token, "Transform")) {
         answer = (Object3D *)parseTransform();
     } else {
-        printf("Unknown token in parseObject: '%s'\n", token);
-        exit(0);
+        fail("Unknown token in parseObject: '%s'", token);
     }
     return answer;
 }
@@ -336,12 +354,10 @@ Group *SceneParser::parseGroup() {
     // simple, and essentially ignores any tree hierarchy)
     //
     char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
 
     // read in the number of objects
-    getToken(token);
-    assert(!strcmp(token, "numObjects"));
+    expectToken("numObjects");
     int num_objects = readInt();
 
     Group *answer = new Group(num_objects);
@@ -352,7 +368,9 @@ Group *SceneParser::parseGroup() {
         if (!strcmp(token, "MaterialIndex")) {
             // change the current material
             int index = readInt();
-            assert(index >= 0 && index <= scene.num_materials);
+            if (index < 0 || index >= scene.num_materials) {
+                fail("MaterialIndex %d out of range", index);
+            }
             current_material = scene.materials[index];
         } else {
             Object3D *object = parseObject(token);
@@ -361,8 +379,8 @@ Group *SceneParser::parseGroup() {
             ++i;
         }
     }
-    getToken(token);
-    assert(!strcmp(token, "}"));
+    expectToken("}");
+    answer->build();
 
     // return the group
     return answer;
@@ -372,70 +390,58 @@ Group *SceneParser::parseGroup() {
 // ====================================================================
 
 Sphere *SceneParser::parseSphere() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
-    getToken(token);
-    assert(!strcmp(token, "center"));
+    expectToken("{");
+    expectToken("center");
     Vector3f center = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "radius"));
+    expectToken("radius");
     float radius = readFloat();
-    getToken(token);
-    assert(!strcmp(token, "}"));
-    assert(current_material != NULL);
+    expectToken("}");
+    if (current_material == NULL) {
+        fail("%s without a MaterialIndex", "Sphere");
+    }
     return new Sphere(center, radius, current_material);
 }
 
 Plane *SceneParser::parsePlane() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
-    getToken(token);
-    assert(!strcmp(token, "normal"));
+    expectToken("{");
+    expectToken("normal");
     Vector3f normal = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "offset"));
+    expectToken("offset");
     float offset = readFloat();
-    getToken(token);
-    assert(!strcmp(token, "}"));
-    assert(current_material != NULL);
+    expectToken("}");
+    if (current_material == NULL) {
+        fail("%s without a MaterialIndex", "Plane");
+    }
     return new Plane(normal, offset, current_material);
 }
 
 Triangle *SceneParser::parseTriangle() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
-    getToken(token);
-    assert(!strcmp(token, "{"));
-    getToken(token);
-    assert(!strcmp(token, "vertex0"));
+    expectToken("{");
+    expectToken("vertex0");
     Vector3f v0 = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "vertex1"));
+    expectToken("vertex1");
     Vector3f v1 = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "vertex2"));
+    expectToken("vertex2");
     Vector3f v2 = readVector3f();
-    getToken(token);
-    assert(!strcmp(token, "}"));
-    assert(current_material != NULL);
+    expectToken("}");
+    if (current_material == NULL) {
+        fail("%s without a MaterialIndex", "Triangle");
+    }
     return new Triangle(v0, v1, v2, current_material);
 }
 
 Mesh *SceneParser::parseTriangleMesh() {
-    char token[MAX_PARSER_TOKEN_LENGTH];
     char filename[MAX_PARSER_TOKEN_LENGTH];
     // get the filename
-    getToken(token);
-    assert(!strcmp(token, "{"));
-    getToken(token);
-    assert(!strcmp(token, "obj_file"));
+    expectToken("{");
+    expectToken("obj_file");
     getToken(filename);
-    getToken(token);
-    assert(!strcmp(token, "}"));
-    const char *ext = &filename[strlen(filename) - 4];
-    assert(!strcmp(ext, ".obj"));
-    Mesh *answer = new Mesh(getRelativePath(filename).string().c_str(), current_material);
+    expectToken("}");
+    size_t length = strlen(filename);
+    if (length < 4 || strcmp(filename + length - 4, ".obj") != 0) {
+        fail("TriangleMesh of '%s', not an .obj file", filename);
+    }
+    Mesh *answer = new Mesh(getRelativePath(filename).string().c_str(), current_material, resources);
 
     return answer;
 }
@@ -444,8 +450,7 @@ Transform *SceneParser::parseTransform() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     Matrix4f matrix = Matrix4f::identity();
     Object3D *object = NULL;
-    getToken(token);
-    assert(!strcmp(token, "{"));
+    expectToken("{");
     // read in transformations:
     // apply to the LEFT side of the current matrix (so the first
     // transform in the list is the last applied to the object)
@@ -467,26 +472,22 @@ Transform *SceneParser::parseTransform() {
         } else if (!strcmp(token, "ZRotate")) {
             matrix = matrix * Matrix4f::rotateZ(DegreesToRadians(readFloat()));
         } else if (!strcmp(token, "Rotate")) {
-            getToken(token);
-            assert(!strcmp(token, "{"));
+            expectToken("{");
             Vector3f axis = readVector3f();
             float degrees = readFloat();
             float radians = DegreesToRadians(degrees);
             matrix = matrix * Matrix4f::rotation(axis, radians);
-            getToken(token);
-            assert(!strcmp(token, "}"));
+            expectToken("}");
         } else if (!strcmp(token, "Matrix4f")) {
             Matrix4f matrix2 = Matrix4f::identity();
-            getToken(token);
-            assert(!strcmp(token, "{"));
+            expectToken("{");
             for (int j = 0; j < 4; j++) {
                 for (int i = 0; i < 4; i++) {
                     float v = readFloat();
                     matrix2(i, j) = v;
                 }
             }
-            getToken(token);
-            assert(!strcmp(token, "}"));
+            expectToken("}");
             matrix = matrix2 * matrix;
         } else {
             // otherwise this must be an object,
@@ -498,8 +499,7 @@ Transform *SceneParser::parseTransform() {
     }
 
     assert(object != NULL);
-    getToken(token);
-    assert(!strcmp(token, "}"));
+    expectToken("}");
     return new Transform(matrix, object);
 }
 
@@ -521,8 +521,7 @@ Vector3f SceneParser::readVector3f() {
     float x, y, z;
     int count = fscanf(file, "%f %f %f", &x, &y, &z);
     if (count != 3) {
-        printf("Error trying to read 3 floats to make a Vector3f\n");
-        assert(0);
+        fail("Error trying to read 3 floats to make a Vector3f");
     }
     return Vector3f(x, y, z);
 }
@@ -531,8 +530,7 @@ Vector2f SceneParser::readVec2f() {
     float u, v;
     int count = fscanf(file, "%f %f", &u, &v);
     if (count != 2) {
-        printf("Error trying to read 2 floats to make a Vec2f\n");
-        assert(0);
+        fail("Error trying to read 2 floats to make a Vec2f");
     }
     return Vector2f(u, v);
 }
@@ -541,8 +539,7 @@ float SceneParser::readFloat() {
     float answer;
     int count = fscanf(file, "%f", &answer);
     if (count != 1) {
-        printf("Error trying to read 1 float\n");
-        assert(0);
+        fail("Error trying to read 1 float");
     }
     return answer;
 }
@@ -551,8 +548,7 @@ int SceneParser::readInt() {
     int answer;
     int count = fscanf(file, "%d", &answer);
     if (count != 1) {
-        printf("Error trying to read 1 int\n");
-        assert(0);
+        fail("Error trying to read 1 int");
     }
     return answer;
 }
@@ -564,8 +560,87 @@ fs::path SceneParser::getRelativePath(const char *resource) {
 // ====================================================================
 // ====================================================================
 
-Scene::Scene(const char *filename) {
-    SceneParser(*this, filename);
+Scene::Scene(const char *filename) : Scene(filename, ResourceProvider::files()) {}
+
+Scene::Scene(const char *filename, const ResourceProvider &resources) {
+    TRACE_SCOPE("load scene", filename);
+    try {
+        SceneParser(*this, filename, resources);
+    } catch (const SceneError &e) {
+        // the parts parsed so far are kept for the destructor
+        error = e.message;
+        return;
+    }
+    indexLights();
+}
+
+void Scene::indexLights() {
+    directionalLights.clear();
+    for (int i = 0; i < num_lights; ++i) {
+        if (dynamic_cast<PointLight *>(lights[i]) == NULL) {
+            directionalLights.push_back(i);
+        }
+    }
+    lightTree.build(lights, num_lights);
+}
+
+void Scene::setCamera(const Vector3f &center, const Vector3f &direction, const Vector3f &up) {
+    this->center = center;
+    this->direction = direction;
+    this->up = up;
+    delete camera;
+    camera = new PerspectiveCamera(center, direction, up, angle_radians);
+}
+
+bool Scene::setTransform(int i, const Matrix4f &m) {
+    if (i < 0 || i >= group->getGroupSize()) {
+        return false;
+    }
+    auto transform = dynamic_cast<Transform *>(group->getObject(i));
+    if (transform == NULL) {
+        return false;
+    }
+    transform->setMatrix(m);
+    group->markDirty(i);
+    return true;
+}
+
+bool Scene::setLight(int i, Light *light) {
+    if (i < 0 || i >= num_lights) {
+        return false;
+    }
+    delete lights[i];
+    lights[i] = light;
+    lightsDirty = true;
+    return true;
+}
+
+void Scene::update() {
+    group->refit();
+    if (lightsDirty) {
+        indexLights();
+        lightsDirty = false;
+    }
+}
+
+void Scene::selectLights(const Vector3f &p, float threshold, int samples, std::minstd_rand &rng,
+                         std::vector<LightSelection> &out) const {
+    out.clear();
+    if (threshold <= 0 && samples <= 0) {
+        for (int i = 0; i < num_lights; ++i) {
+            out.push_back({i, 1});
+        }
+        return;
+    }
+    // directional lights do not fall off, they are always shaded
+    for (int i : directionalLights) {
+        out.push_back({i, 1});
+    }
+    if (samples > 0) {
+        lightTree.sample(p, samples, rng, out);
+    } else {
+        lightTree.cull(p, threshold, out);
+    }
 }
 
 Scene::~Scene() {
@@ -573,6 +648,8 @@ Scene::~Scene() {
         delete group;
     if (camera != NULL)
         delete camera;
+    if (thinLenCamera != NULL)
+        delete thinLenCamera;
     int i;
     for (i = 0; i < num_materials; ++i) {
         delete materials[i];
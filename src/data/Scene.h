@@ -11,7 +11,9 @@
 #include "Camera.h"
 #include "CubeMap.h"
 #include "Light.h"
+#include "LightTree.h"
 #include "Material.h"
+#include "Resource.h"
 #include <cassert>
 #include <filesystem>
 #include <vecmath.h>
@@ -23,8 +25,17 @@ class Scene {
 
 public:
     Scene(const char *filename);
+    ///@brief parses the scene at filename and the files it names from
+    /// resources, which only has to live during the construction; check
+    /// getError() before using it
+    Scene(const char *filename, const ResourceProvider &resources);
     ~Scene();
 
+    ///@return why the scene could not be loaded, empty if it was
+    const std::string &getError() const {
+        return error;
+    }
+
     Group &getGroup() const {
         return *group;
     }
@@ -50,6 +61,11 @@ public:
         assert(i >= 0 && i < num_lights);
         return *lights[i];
     }
+    ///@brief lights to shade p with, all of them unless a cull threshold
+    /// or a number of light samples is given
+    ///@param rng draws the samples, one per rendering thread
+    void selectLights(const Vector3f &p, float threshold, int samples, std::minstd_rand &rng,
+                      std::vector<LightSelection> &out) const;
     int getNumMaterials() const {
         return num_materials;
     }
@@ -57,13 +73,41 @@ public:
         assert(i >= 0 && i < num_materials);
         return *materials[i];
     }
+    ///@return the index of m, or -1 if it is not a material of the scene
+    int getMaterialIndex(const Material *m) const {
+        for (int i = 0; i < num_materials; ++i) {
+            if (materials[i] == m) {
+                return i;
+            }
+        }
+        return -1;
+    }
     bool hasCubeMap() const {
         return cubemap != NULL;
     }
     void setThinLensCamera(float focus_dist) {
         useThinLenCamera = true;
+        delete thinLenCamera;
         thinLenCamera = new ThinLensCamera(center, direction, up, angle_radians, focus_dist);
     }
+    ///@brief goes back to the camera of the scene file, for a scene
+    /// reused across renders
+    void usePerspectiveCamera() {
+        useThinLenCamera = false;
+    }
+
+    // updates between the frames of an animation, call update() before
+    // rendering the next frame
+    void setCamera(const Vector3f &center, const Vector3f &direction, const Vector3f &up);
+    ///@brief sets the matrix of top-level object i
+    ///@return false if there is no object i or it is not a Transform
+    bool setTransform(int i, const Matrix4f &m);
+    ///@brief replaces light i, the scene takes ownership of light
+    ///@return false, and leaves light to the caller, if there is no light i
+    bool setLight(int i, Light *light);
+    ///@brief refits the bounds of the moved objects, meshes keep their
+    /// octrees since those are in object space, and reindexes the lights
+    void update();
 
 private:
     Group *group = NULL;
@@ -74,10 +118,17 @@ private:
     Vector3f ambient_light = Vector3f(0, 0, 0);
     int num_lights = 0;
     Light **lights = NULL;
+    std::vector<int> directionalLights;
+    LightTree lightTree;
     int num_materials = 0;
     Material **materials = NULL;
     CubeMap *cubemap = NULL;
 
+    bool lightsDirty = false;
+    void indexLights();
+
+    std::string error;
+
     Vector3f center, direction, up;
     float angle_radians;
 };
@@ -85,10 +136,11 @@ private:
 class SceneParser {
     friend class Scene;
 
-    SceneParser(Scene &scene, const char *filename);
+    SceneParser(Scene &scene, const char *filename, const ResourceProvider &resources);
 
     Scene &scene;
     const char *filename;
+    const ResourceProvider &resources;
     FILE *file;
     Material *current_material;
 
@@ -112,6 +164,11 @@ class SceneParser {
     Mesh *parseTriangleMesh();
     Transform *parseTransform();
 
+    ///@brief ends the parse with the message of format, as printf does,
+    /// the scene gets it as its error
+    [[noreturn]] void fail(const char *format, ...);
+    ///@brief reads the next token, which has to be expected
+    void expectToken(const char *expected);
     int getToken(char token[MAX_PARSER_TOKEN_LENGTH]);
     Vector3f readVector3f();
     Vector2f readVec2f();
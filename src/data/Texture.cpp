@@ -1,4 +1,6 @@
 #include "Texture.h"
+#include "../render/Trace.h"
+#include <iostream>
 
 Texture::~Texture() {
     if (bimg != 0) {
@@ -10,10 +12,22 @@ bool Texture::valid() const {
     return bimg != 0;
 }
 
-void Texture::load(const char *filename) {
-    bimg = new bitmap_image(filename);
+void Texture::load(const char *filename, const ResourceProvider &resources) {
+    TRACE_SCOPE("load texture", filename);
+    Resource file;
+    if (!resources.open(filename, file)) {
+        std::cerr << "Cannot open texture " << filename << std::endl;
+        return;
+    }
+    ResourceStream stream(file.data);
+    bimg = new bitmap_image(stream);
     height = bimg->height();
     width = bimg->width();
+    // an invalid file leaves the material untextured
+    if (width == 0 || height == 0) {
+        delete bimg;
+        bimg = 0;
+    }
 }
 
 void Texture::operator()(int x, int y, unsigned char *color) const {
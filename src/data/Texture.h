@@ -1,6 +1,7 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "Resource.h"
 #include "bitmap_image.hpp"
 #include <vecmath.h>
 
@@ -12,7 +13,9 @@ public:
     ~Texture();
 
     bool valid() const;
-    void load(const char *filename);
+    ///@brief reads the bitmap at filename from resources, a missing or
+    /// invalid one leaves the texture invalid
+    void load(const char *filename, const ResourceProvider &resources = ResourceProvider::files());
     void operator()(int x, int y, unsigned char *color) const;
     ///@param x assumed to be between 0 and 1
     Vector3f operator()(float x, float y, bool pixelated = false) const;
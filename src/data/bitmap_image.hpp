@@ -73,8 +73,8 @@ struct bitmap_information_header {
     }
 };
 
-inline void read_bih(std::ifstream &stream, bitmap_information_header &bih);
-inline void read_bfh(std::ifstream &stream, bitmap_file_header &bfh);
+inline void read_bih(std::istream &stream, bitmap_information_header &bih);
+inline void read_bfh(std::istream &stream, bitmap_file_header &bfh);
 inline void write_bih(std::ofstream &stream, const bitmap_information_header &bih);
 inline void write_bfh(std::ofstream &stream, const bitmap_file_header &bfh);
 template <typename T>
@@ -121,6 +121,19 @@ public:
         load_bitmap();
     }
 
+    ///@brief reads a bitmap file from stream, such as one in memory
+    bitmap_image(std::istream &stream)
+        : file_name_(""),
+          data_(0),
+          bytes_per_pixel_(0),
+          length_(0),
+          width_(0),
+          height_(0),
+          row_increment_(0),
+          channel_mode_(bgr_mode) {
+        load_bitmap(stream);
+    }
+
     bitmap_image(const unsigned int width, const unsigned int height)
         : file_name_(""),
           data_(0),
@@ -257,7 +270,9 @@ private:
             std::cerr << "bitmap_image::load_bitmap() ERROR: bitmap_image - file " << file_name_ << " not found!" << std::endl;
             return;
         }
-
+        load_bitmap(stream);
+    }
+    void load_bitmap(std::istream &stream) {
         bitmap_file_header bfh;
         bitmap_information_header bih;
 
@@ -265,13 +280,11 @@ private:
         read_bih(stream, bih);
 
         if (bfh.type != 19778) {
-            stream.close();
             std::cerr << "bitmap_image::load_bitmap() ERROR: bitmap_image - Invalid type value " << bfh.type << " expected 19778." << std::endl;
             return;
         }
 
         if (bih.bit_count != 24) {
-            stream.close();
             std::cerr << "bitmap_image::load_bitmap() ERROR: bitmap_image - Invalid bit depth " << bih.bit_count << " expected 24." << std::endl;
             return;
         }
@@ -322,7 +335,7 @@ inline unsigned int flip(const unsigned int &v) {
             ((v & 0x0000FF00) << 0x08));
 }
 template <typename T>
-inline void read_from_stream(std::ifstream &stream, T &t) {
+inline void read_from_stream(std::istream &stream, T &t) {
     stream.read(reinterpret_cast<char *>(&t), sizeof(T));
 }
 
@@ -331,7 +344,7 @@ inline void write_to_stream(std::ofstream &stream, const T &t) {
     stream.write(reinterpret_cast<const char *>(&t), sizeof(T));
 }
 
-inline void read_bfh(std::ifstream &stream, bitmap_file_header &bfh) {
+inline void read_bfh(std::istream &stream, bitmap_file_header &bfh) {
     read_from_stream(stream, bfh.type);
     read_from_stream(stream, bfh.size);
     read_from_stream(stream, bfh.reserved1);
@@ -362,7 +375,7 @@ inline void write_bfh(std::ofstream &stream, const bitmap_file_header &bfh) {
     write_to_stream(stream, bfh.reserved2);
     write_to_stream(stream, bfh.off_bits);
 }
-inline void read_bih(std::ifstream &stream, bitmap_information_header &bih) {
+inline void read_bih(std::istream &stream, bitmap_information_header &bih) {
     read_from_stream(stream, bih.size);
     read_from_stream(stream, bih.width);
     read_from_stream(stream, bih.height);
@@ -1,19 +1,91 @@
+#include "Bench.h"
 #include "Entry.h"
+#include "Frames.h"
+#include "Microbench.h"
 #include "ProgressBar.h"
+#include "Server.h"
 #include "render/Arguments.h"
+#include "render/Trace.h"
+#include <csignal>
 #include <iostream>
 
 using namespace std;
 
-int main(int argc, const char *argv[]) {
-    const Arguments args(argc, argv);
+CancellationToken interrupted;
+
+void onInterrupt(int) {
+    interrupted.cancel();
+}
+
+///@return the exit status
+int run(const Arguments &args) {
+    if (args.server) {
+        return serve(args, &interrupted);
+    }
+    if (args.jobsFile != NULL) {
+        return runJobFile(args, &interrupted);
+    }
+    if (args.benchReps > 0) {
+        return runBenchmark(args, &interrupted);
+    }
+    if (args.microbenchRays > 0) {
+        return runMicrobenchmark(args);
+    }
 
     if (args.inputFile == NULL) {
         cout << "Insufficient argument: expecting -input [inputFile], exiting ..." << endl;
         return 1;
     }
 
-    entry(args, printProgress);
+    if (args.framesFile != NULL) {
+        return renderFrames(args, &interrupted);
+    }
+
+    // ctrl-c stops the render after the current tile and keeps what
+    // was rendered so far
+    auto result = entry(args, printProgress, nullptr, &interrupted);
+    if (!result.error.empty()) {
+        cout << result.error << endl;
+        return 1;
+    }
 
-    return 0;
+    return result.cancelled ? 130 : 0;
+}
+
+int main(int argc, const char *argv[]) {
+    Arguments args;
+    string error;
+    if (!args.parse(argc, argv, error)) {
+        cout << error << endl;
+        return 1;
+    }
+    if (args.noArgs) {
+        return 0;
+    }
+    // the replies of a server on stdout are read by its client, the
+    // arguments are only echoed to a terminal
+    if (!args.server) {
+        for (int i = 1; i < argc; ++i) {
+            cout << "Argument " << i << " is: " << argv[i] << endl;
+        }
+    }
+
+    // without SA_RESTART, so that ctrl-c also ends a server waiting for
+    // its next job
+    struct sigaction action = {};
+    action.sa_handler = onInterrupt;
+    sigaction(SIGINT, &action, NULL);
+
+    if (args.traceFile != NULL) {
+        Trace::start();
+    }
+    int status = run(args);
+    if (args.traceFile != NULL) {
+        if (Trace::write(args.traceFile)) {
+            cout << "Trace written to " << args.traceFile << endl;
+        } else {
+            cout << "cannot write trace " << args.traceFile << endl;
+        }
+    }
+    return status;
 }
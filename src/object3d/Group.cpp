@@ -1,9 +1,203 @@
 #include "Group.h"
+#include "../render/Stats.h"
+#include "../render/Trace.h"
+#include <algorithm>
+#include <mutex>
+
+// objects per leaf of the hierarchy
+#define LEAF_SIZE 2
+
+// taken by the first intersection of a group not built yet, which the
+// threads rendering the first tiles may make at once
+static mutex buildMutex;
+
+static void extend(Box &box, const Box &b) {
+    for (int dim = 0; dim < 3; dim++) {
+        box.mn[dim] = std::min(box.mn[dim], b.mn[dim]);
+        box.mx[dim] = std::max(box.mx[dim], b.mx[dim]);
+    }
+}
+
+///@brief slab test of r against box, for hits between tmin and tmax
+static bool hitBox(const Box &box, const Ray &r, float tmin, float tmax) {
+    const Vector3f &o = r.getOrigin(), &d = r.getDirection();
+    for (int dim = 0; dim < 3; dim++) {
+        float inv = 1.0f / d[dim];
+        float t0 = (box.mn[dim] - o[dim]) * inv, t1 = (box.mx[dim] - o[dim]) * inv;
+        if (inv < 0) {
+            std::swap(t0, t1);
+        }
+        // written so that a NaN from a ray in the slab plane keeps the box
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+        if (tmax < tmin) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Group::build() {
+    TRACE_SCOPE("build bvh");
+    int n = objects.size();
+    bounds.assign(n, Box());
+    dirty.assign(n, false);
+    order.clear();
+    unbounded.clear();
+    nodes.clear();
+    for (int i = 0; i < n; i++) {
+        if (objects[i]->getBounds(bounds[i])) {
+            order.push_back(i);
+        } else {
+            unbounded.push_back(i);
+        }
+    }
+    if (!order.empty()) {
+        nodes.reserve(2 * order.size());
+        buildNode(0, order.size());
+    }
+    built = true;
+}
+
+///@brief splits at the median of the longest axis of the box centers
+int Group::buildNode(int begin, int end) {
+    int idx = nodes.size();
+    nodes.emplace_back();
+    BvhNode node;
+    node.box = bounds[order[begin]];
+    Box centers(node.box.mn + node.box.mx, node.box.mn + node.box.mx);
+    for (int i = begin; i < end; i++) {
+        const Box &b = bounds[order[i]];
+        extend(node.box, b);
+        extend(centers, Box(b.mn + b.mx, b.mn + b.mx));
+    }
+    if (end - begin <= LEAF_SIZE) {
+        node.begin = begin;
+        node.count = end - begin;
+    } else {
+        Vector3f extent = centers.mx - centers.mn;
+        int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2)
+                                         : (extent[1] > extent[2] ? 1 : 2);
+        int mid = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [this, axis](int a, int b) {
+                             return bounds[a].mn[axis] + bounds[a].mx[axis] <
+                                    bounds[b].mn[axis] + bounds[b].mx[axis];
+                         });
+        node.child[0] = buildNode(begin, mid);
+        node.child[1] = buildNode(mid, end);
+    }
+    nodes[idx] = node;
+    return idx;
+}
+
+void Group::refit() {
+    if (!built) {
+        build();
+        return;
+    }
+    bool changed = false;
+    for (int i : order) {
+        if (dirty[i]) {
+            objects[i]->getBounds(bounds[i]);
+            dirty[i] = false;
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    // children are stored after their parent
+    for (int k = nodes.size() - 1; k >= 0; k--) {
+        BvhNode &node = nodes[k];
+        if (node.child[0] < 0) {
+            node.box = bounds[order[node.begin]];
+            for (int i = node.begin + 1; i < node.begin + node.count; i++) {
+                extend(node.box, bounds[order[i]]);
+            }
+        } else {
+            node.box = nodes[node.child[0]].box;
+            extend(node.box, nodes[node.child[1]].box);
+        }
+    }
+}
+
+bool Group::getBounds(Box &box) const {
+    if (objects.empty()) {
+        return false;
+    }
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        Box b;
+        if (!objects[i]->getBounds(b)) {
+            return false;
+        }
+        if (i == 0) {
+            box = b;
+        } else {
+            extend(box, b);
+        }
+    }
+    return true;
+}
+
+template <typename Test, typename TMax>
+void Group::traverse(const Ray &r, float tmin, TMax tmax, Test test) {
+    if (!built) {
+        lock_guard<mutex> lock(buildMutex);
+        if (!built) {
+            build();
+        }
+    }
+    for (int i : unbounded) {
+        if (test(i)) {
+            return;
+        }
+    }
+    if (nodes.empty()) {
+        return;
+    }
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode &node = nodes[stack[--top]];
+        STAT_INC(STAT_BVH_NODES);
+        if (!hitBox(node.box, r, tmin, tmax())) {
+            continue;
+        }
+        if (node.child[0] < 0) {
+            for (int i = node.begin; i < node.begin + node.count; i++) {
+                if (test(order[i])) {
+                    return;
+                }
+            }
+        } else {
+            stack[top++] = node.child[0];
+            stack[top++] = node.child[1];
+        }
+    }
+}
 
 bool Group::intersect(const Ray &r, Hit &h, float tmin) {
     bool res = false;
-    for (auto obj : objects)
-        if (obj->intersect(r, h, tmin))
+    traverse(r, tmin, [&h]() { return h.getT(); }, [&](int i) {
+        if (objects[i]->intersect(r, h, tmin)) {
+            h.objectIndex = i;
             res = true;
+        }
+        return false;
+    });
+    return res;
+}
+
+int Group::occluder(const Ray &r, float tmin, float tmax, int skip) {
+    int res = -1;
+    traverse(r, tmin, [tmax]() { return tmax; }, [&](int i) {
+        Hit h(tmax);
+        if (i != skip && objects[i]->intersect(r, h, tmin)) {
+            res = i;
+        }
+        return res >= 0;
+    });
     return res;
 }
@@ -2,6 +2,7 @@
 #define GROUP_H
 
 #include "Object3D.h"
+#include <atomic>
 #include <vector>
 
 class Group : public Object3D {
@@ -16,11 +17,54 @@ public:
     }
     void addObject(Object3D *obj) {
         objects.push_back(obj);
+        built = false;
+    }
+    Object3D *getObject(int i) const {
+        return objects[i];
     }
     virtual bool intersect(const Ray &r, Hit &h, float tmin);
+    ///@brief any-hit query for shadow rays
+    ///@param skip object known not to block the ray, -1 for none
+    ///@return index of an object hit between tmin and tmax, -1 if none
+    int occluder(const Ray &r, float tmin, float tmax, int skip = -1);
+    virtual bool getBounds(Box &box) const;
+
+    ///@brief builds the bounding volume hierarchy over the objects,
+    /// done on the first intersection after objects were added, by one
+    /// thread while the others wait
+    void build();
+    ///@brief marks object i as moved, its bounds are recomputed by refit
+    void markDirty(int i) {
+        dirty[i] = true;
+    }
+    ///@brief updates the bounds of the dirty objects and of the nodes
+    /// above them, keeping the hierarchy
+    void refit();
 
 private:
+    struct BvhNode {
+        Box box;
+        // inner nodes have two children, leaves the objects
+        // [begin, begin + count) of order
+        int child[2] = {-1, -1};
+        int begin = 0;
+        int count = 0;
+    };
+
     vector<Object3D *> objects;
+    std::atomic<bool> built{false};
+    vector<BvhNode> nodes;
+    vector<int> order;
+    // objects without bounds, e.g. planes, always tested
+    vector<int> unbounded;
+    vector<Box> bounds;
+    vector<bool> dirty;
+
+    int buildNode(int begin, int end);
+    ///@brief calls test(i) on the objects whose bounds r enters between
+    /// tmin and tmax(), stops when test returns true
+    template <typename Test, typename TMax>
+    void traverse(const Ray &r, float tmin, TMax tmax, Test test);
 };
 
 #endif // GROUP_H
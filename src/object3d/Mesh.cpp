@@ -1,16 +1,18 @@
 #include "Mesh.h"
+#include "../render/Trace.h"
 #include <algorithm>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <utility>
 
 #define SMOOTH (v.size() > 120)
 
-void intersectCall(int idx, void **arg) {
+///@param arg the mesh, the result so far, and the ray, hit and tmin of
+/// the query
+static void intersectCall(int idx, void **arg) {
     Mesh *m = (Mesh *)(arg[0]);
-    bool result = m->intersectTrig(idx);
+    bool result = m->intersectTrig(idx, *(const Ray *)arg[2], *(Hit *)arg[3], *(float *)arg[4]);
     arg[1] = (void *)(((bool)arg[1]) || result);
 }
 bool Mesh::intersect(const Ray &r, Hit &h, float tmin) {
@@ -32,19 +34,18 @@ bool Mesh::intersect(const Ray &r, Hit &h, float tmin) {
         }
         return result;
     } else {
-        ray = &r;
-        hit = &h;
-        tm = tmin;
-        void *arg[2];
+        // the query lives on the stack, threads intersect the mesh at once
+        void *arg[5];
         arg[0] = this;
         arg[1] = 0;
-        octree.arg = arg;
-        octree.termFunc = intersectCall;
-        octree.intersect(r);
+        arg[2] = (void *)&r;
+        arg[3] = &h;
+        arg[4] = &tmin;
+        octree.intersect(r, intersectCall, arg);
         return arg[1];
     }
 }
-bool Mesh ::intersectTrig(int idx) {
+bool Mesh ::intersectTrig(int idx, const Ray &r, Hit &h, float tmin) {
     bool result = false;
     Triangle triangle(v[t[idx][0]],
                       v[t[idx][1]], v[t[idx][2]], material);
@@ -66,16 +67,17 @@ bool Mesh ::intersectTrig(int idx) {
         }
         triangle.hasTex = true;
     }
-    result = triangle.intersect(*ray, *hit, tm);
+    result = triangle.intersect(r, h, tmin);
     return result;
 }
-Mesh::Mesh(const char *filename, Material *material) : Object3D(material) {
-    std::ifstream f;
-    f.open(filename);
-    if (!f.is_open()) {
+Mesh::Mesh(const char *filename, Material *material, const ResourceProvider &resources) : Object3D(material) {
+    TRACE_SCOPE("load mesh", filename);
+    Resource file;
+    if (!resources.open(filename, file)) {
         std::cout << "Cannot open " << filename << "\n";
         return;
     }
+    ResourceStream f(file.data);
     std::string line;
     std::string vTok("v");
     std::string fTok("f");
@@ -127,12 +129,12 @@ Mesh::Mesh(const char *filename, Material *material) : Object3D(material) {
             texCoord.push_back(texcoord);
         }
     }
-    f.close();
     compute_norm();
     octree.build(*this);
 }
 
 void Mesh::compute_norm() {
+    TRACE_SCOPE("compute normals");
     sn.resize(v.size());
     for (unsigned int ii = 0; ii < t.size(); ii++) {
         Vector3f a = v[t[ii][1]] - v[t[ii][0]];
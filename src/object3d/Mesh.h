@@ -2,6 +2,7 @@
 #define MESH_H
 
 #include "../data/Octree.h"
+#include "../data/Resource.h"
 #include "Object3D.h"
 #include "Triangle.h"
 #include <vecmath.h>
@@ -22,7 +23,8 @@ struct Trig {
 
 class Mesh : public Object3D {
 public:
-    Mesh(const char *filename, Material *m);
+    ///@brief reads the OBJ file at filename from resources
+    Mesh(const char *filename, Material *m, const ResourceProvider &resources = ResourceProvider::files());
 
     std::vector<Vector3f> v;
     std::vector<Trig> t;
@@ -31,12 +33,13 @@ public:
     std::vector<Vector2f> texCoord;
 
     virtual bool intersect(const Ray &r, Hit &h, float tmin);
-    virtual bool intersectTrig(int idx);
+    virtual bool intersectTrig(int idx, const Ray &r, Hit &h, float tmin);
+    virtual bool getBounds(Box &box) const {
+        box = octree.box;
+        return true;
+    }
 
 private:
-    const Ray *ray;
-    Hit *hit;
-    float tm;
     void compute_norm();
     Octree octree;
 };
@@ -5,6 +5,7 @@
 
 #include "../data/Hit.h"
 #include "../data/Material.h"
+#include "../data/Octree.h"
 #include "../data/Ray.h"
 
 class Object3D {
@@ -14,6 +15,11 @@ public:
         : material(material) {}
     virtual ~Object3D() {}
     virtual bool intersect(const Ray &r, Hit &h, float tmin) = 0;
+    ///@brief axis aligned bounds in the space of the object
+    ///@return false if the object is unbounded
+    virtual bool getBounds(__attribute__((unused)) Box &box) const {
+        return false;
+    }
     char *type;
 
 protected:
@@ -1,4 +1,5 @@
 #include "Sphere.h"
+#include "../render/Stats.h"
 
 #define SQUARED(x) x *x
 
@@ -10,6 +11,7 @@ bool Sphere::intersect(const Ray &r, Hit &h, float tmin) {
      * d = sqrt(b^2 - 4ac)
      * t = (-b +- d) / 2a
      */
+    STAT_INC(STAT_SPHERE_TESTS);
     auto Ro = r.getOrigin() - center;
     auto Rd = r.getDirection();
     float a = Rd.absSquared();
@@ -23,6 +25,7 @@ bool Sphere::intersect(const Ray &r, Hit &h, float tmin) {
             if (t >= tmin && t <= h.getT()) {
                 auto normal = (Ro + t * Rd).normalized();
                 h.set(t, material, normal);
+                STAT_INC(STAT_HITS);
                 return true;
             }
         }
@@ -12,6 +12,10 @@ public:
         : Object3D(material), center(center), radius(radius) {}
     ~Sphere() {}
     virtual bool intersect(const Ray &r, Hit &h, float tmin);
+    virtual bool getBounds(Box &box) const {
+        box = Box(center - Vector3f(radius), center + Vector3f(radius));
+        return true;
+    }
 
 protected:
     Vector3f center;
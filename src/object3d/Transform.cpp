@@ -1,4 +1,5 @@
 #include "Transform.h"
+#include <algorithm>
 
 bool Transform::intersect(const Ray &r, Hit &h, float tmin) {
     auto transformedOrigin = (invM * Vector4f(r.getOrigin(), 1)).xyz();
@@ -11,3 +12,25 @@ bool Transform::intersect(const Ray &r, Hit &h, float tmin) {
     }
     return false;
 }
+
+bool Transform::getBounds(Box &box) const {
+    Box local;
+    if (!o->getBounds(local)) {
+        return false;
+    }
+    // bounds of the eight transformed corners
+    for (int i = 0; i < 8; i++) {
+        Vector3f corner(i & 1 ? local.mx[0] : local.mn[0],
+                        i & 2 ? local.mx[1] : local.mn[1],
+                        i & 4 ? local.mx[2] : local.mn[2]);
+        Vector3f p = (m * Vector4f(corner, 1)).xyz();
+        if (i == 0) {
+            box = Box(p, p);
+        }
+        for (int dim = 0; dim < 3; dim++) {
+            box.mn[dim] = std::min(box.mn[dim], p[dim]);
+            box.mx[dim] = std::max(box.mx[dim], p[dim]);
+        }
+    }
+    return true;
+}
@@ -11,6 +11,17 @@ public:
         : o(obj), m(m), invM(m.inverse()) {}
     ~Transform() {}
     virtual bool intersect(const Ray &r, Hit &h, float tmin);
+    virtual bool getBounds(Box &box) const;
+
+    const Matrix4f &getMatrix() const {
+        return m;
+    }
+    ///@brief moves the object, the bounds of the groups above have to be
+    /// refit afterwards
+    void setMatrix(const Matrix4f &matrix) {
+        m = matrix;
+        invM = matrix.inverse();
+    }
 
 protected:
     Object3D *o; // un-transformed object
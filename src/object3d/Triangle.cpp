@@ -1,4 +1,6 @@
 #include "Triangle.h"
+#include "../render/Stats.h"
+#include <algorithm>
 
 void Triangle::setTbn(Hit &h) {
     auto &[p0, p1, p2] = texCoords;
@@ -13,7 +15,17 @@ void Triangle::setTbn(Hit &h) {
     h.setTbn(Matrix3f(t, b, n));
 }
 
+void Triangle::setHit(Hit &h, float t, float alpha, float beta, float gamma) {
+    Vector3f normal = (alpha * normals[0] + beta * normals[1] + gamma * normals[2]).normalized();
+    h.set(t, material, normal);
+    Vector2f coord = alpha * texCoords[0] + beta * texCoords[1] + gamma * texCoords[2];
+    h.setTexCoord(coord);
+    setTbn(h);
+    STAT_INC(STAT_HITS);
+}
+
 bool Triangle::intersect(const Ray &r, Hit &h, float tmin) {
+    STAT_INC(STAT_TRIANGLE_TESTS);
     auto rd = r.getDirection();
     auto ro = r.getOrigin();
     float detA = Matrix3f(a - b, a - c, rd).determinant();
@@ -23,13 +35,17 @@ bool Triangle::intersect(const Ray &r, Hit &h, float tmin) {
     if (alpha >= 0 && beta >= 0 && gamma >= 0) {
         float t = Matrix3f(a - b, a - c, a - ro).determinant() / detA;
         if (t > tmin && t < h.getT()) {
-            Vector3f normal = (alpha * normals[0] + beta * normals[1] + gamma * normals[2]).normalized();
-            h.set(t, material, normal);
-            Vector2f coord = alpha * texCoords[0] + beta * texCoords[1] + gamma * texCoords[2];
-            h.setTexCoord(coord);
-            setTbn(h);
+            setHit(h, t, alpha, beta, gamma);
             return true;
         }
     }
     return false;
 }
+
+bool Triangle::getBounds(Box &box) const {
+    for (int dim = 0; dim < 3; dim++) {
+        box.mn[dim] = std::min(a[dim], std::min(b[dim], c[dim]));
+        box.mx[dim] = std::max(a[dim], std::max(b[dim], c[dim]));
+    }
+    return true;
+}
@@ -11,6 +11,7 @@ public:
     Triangle(const Vector3f &a, const Vector3f &b, const Vector3f &c, Material *m)
         : Object3D(m), a(a), b(b), c(c) {}
     virtual bool intersect(const Ray &ray, Hit &hit, float tmin);
+    virtual bool getBounds(Box &box) const;
     bool hasTex = false;
     Vector3f normals[3];
     Vector2f texCoords[3];
@@ -20,6 +21,9 @@ protected:
     Vector3f b;
     Vector3f c;
     void setTbn(Hit &h);
+    ///@brief sets h to the point of barycentric coordinates alpha, beta
+    /// and gamma at t, with its interpolated normal and texture coordinates
+    void setHit(Hit &h, float t, float alpha, float beta, float gamma);
 };
 
 #endif // TRIANGLE_H
@@ -0,0 +1,100 @@
+#include "Aov.h"
+#include "../data/Hit.h"
+#include "../data/Scene.h"
+#include "Arguments.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static const char *aovNames[NUM_AOVS] = {"depth", "normals", "material", "uv", "position", "cost"};
+
+Aov aovFromName(const char *name) {
+    int i = 0;
+    while (i < NUM_AOVS && strcmp(aovNames[i], name) != 0) {
+        ++i;
+    }
+    return (Aov)i;
+}
+
+void AovSample::set(const Scene &scene, const Ray &ray, const Hit &h) {
+    hit = true;
+    depth = h.getT();
+    normal = h.getNormal();
+    material = scene.getMaterialIndex(h.getMaterial());
+    object = h.objectIndex;
+    uv = h.hasTex ? h.texCoord : Vector2f(0, 0);
+    position = ray(h.getT());
+}
+
+///@brief well separated colors for consecutive ids
+static Vector3f idColor(int id) {
+    float r = (id + 1) * 0.618034f, g = (id + 1) * 0.414214f, b = (id + 1) * 0.732051f;
+    return Vector3f(r - floor(r), g - floor(g), b - floor(b));
+}
+
+///@brief black, blue, red, yellow and white as t goes from 0 to 1
+static Vector3f heatColor(float t) {
+    const Vector3f stops[5] = {Vector3f(0, 0, 0), Vector3f(0, 0, 1), Vector3f(1, 0, 0),
+                               Vector3f(1, 1, 0), Vector3f(1, 1, 1)};
+    t = min(max(t, 0.0f), 1.0f) * 4;
+    int k = min((int)t, 3);
+    return stops[k] + (t - k) * (stops[k + 1] - stops[k]);
+}
+
+float AovBuffers::costScale(bool steps) const {
+    vector<float> costs;
+    for (auto &s : samples) {
+        costs.push_back(steps ? s.steps : s.cycles);
+    }
+    if (costs.empty()) {
+        return 0;
+    }
+    // a few pixels interrupted by the system would otherwise leave the
+    // rest of the heatmap dark
+    auto p99 = costs.begin() + (costs.size() - 1) * 99 / 100;
+    nth_element(costs.begin(), p99, costs.end());
+    return *p99;
+}
+
+Image AovBuffers::toImage(Aov aov, const Arguments &args, bool floatOutput) const {
+    Image img(width, height);
+    float scale = aov == AOV_COST ? costScale(args.costSteps) : 0;
+    for (int i = 0; i < width; ++i) {
+        for (int j = 0; j < height; ++j) {
+            const AovSample &s = at(i, j);
+            if (!s.hit && aov != AOV_COST) {
+                continue;
+            }
+            Vector3f color;
+            switch (aov) {
+            case AOV_DEPTH:
+                if (s.depth < args.depthMin) {
+                    color = Vector3f(1);
+                } else if (s.depth <= args.depthMax) {
+                    color = Vector3f((args.depthMax - s.depth) / (args.depthMax - args.depthMin));
+                }
+                break;
+            case AOV_NORMALS:
+                color = Vector3f(fabs(s.normal[0]), fabs(s.normal[1]), fabs(s.normal[2]));
+                break;
+            case AOV_MATERIAL:
+                color = idColor(s.material);
+                break;
+            case AOV_UV:
+                color = Vector3f(s.uv[0], s.uv[1], 0);
+                break;
+            case AOV_COST: {
+                float cost = args.costSteps ? s.steps : s.cycles;
+                color = floatOutput ? Vector3f(cost) : heatColor(scale > 0 ? cost / scale : 0);
+                break;
+            }
+            default:
+                color = s.position;
+            }
+            img.setPixel(i, j, color);
+        }
+    }
+    return img;
+}
@@ -0,0 +1,76 @@
+#ifndef AOV_H
+#define AOV_H
+
+#include "Image.h"
+#include <vecmath.h>
+#include <vector>
+
+class Hit;
+class Ray;
+class Scene;
+struct Arguments;
+
+///@brief arbitrary output variables, written from the primary hits of
+/// the color pass instead of tracing the primary rays again
+enum Aov {
+    AOV_DEPTH,
+    AOV_NORMALS,
+    AOV_MATERIAL,
+    AOV_UV,
+    AOV_POSITION,
+    AOV_COST,
+    NUM_AOVS
+};
+
+///@return the aov called name, or NUM_AOVS if there is none
+Aov aovFromName(const char *name);
+
+///@brief what the primary ray of a pixel hit
+struct AovSample {
+    bool hit = false;
+    float depth = 0;
+    Vector3f normal;
+    int material = -1;
+    int object = -1;
+    Vector2f uv;
+    Vector3f position;
+    // what rendering the sample took, also for a miss
+    float cycles = 0;
+    float steps = 0;
+
+    void set(const Scene &scene, const Ray &ray, const Hit &h);
+};
+
+class AovBuffers {
+public:
+    AovBuffers(int w, int h)
+        : width(w), height(h), samples(w * h) {}
+
+    int getWidth() const {
+        return width;
+    }
+    int getHeight() const {
+        return height;
+    }
+    AovSample &at(int x, int y) {
+        return samples[y * width + x];
+    }
+    const AovSample &at(int x, int y) const {
+        return samples[y * width + x];
+    }
+    ///@brief aov as a displayable image: depth mapped from
+    /// [depthMin, depthMax] to [1, 0], absolute normals, a color per
+    /// material, uv in red and green, the raw hit position, and the cost
+    /// as a heatmap up to costScale, or raw for a float output file
+    Image toImage(Aov aov, const Arguments &args, bool floatOutput = false) const;
+    ///@brief the 99th percentile of the cost of the pixels, in cycles or
+    /// in steps, mapped to white by the heatmap
+    float costScale(bool steps) const;
+
+private:
+    int width;
+    int height;
+    std::vector<AovSample> samples;
+};
+
+#endif // AOV_H
@@ -1,66 +1,214 @@
-#include "Arguments.h"
-#include <iostream>
-
-Arguments::Arguments(int argc, const char **argv) {
-    // This loop loops over each of the input arguments.
-    // argNum is initialized to 1 because the first
-    // "argument" provided to the program is actually the
-    // name of the executable (in our case, "a5").
-    for (int i = 1; i < argc; ++i) {
-        std::cout << "Argument " << i << " is: " << argv[i] << std::endl;
-    }
-    for (int i = 1; i < argc; ++i) {
-        if (!strcmp(argv[i], "-input")) {
-            i++;
-            assert(i < argc);
-            inputFile = argv[i];
-        } else if (!strcmp(argv[i], "-output")) {
-            i++;
-            assert(i < argc);
-            outputFile = argv[i];
-        } else if (!strcmp(argv[i], "-size")) {
-            i++;
-            assert(i < argc);
-            width = atoi(argv[i]); 
-            i++;
-            assert(i < argc);
-            height = atoi(argv[i]);
-        } else if (!strcmp(argv[i], "-depth")) {
-            i++;
-            assert(i < argc);
-            depthMin = (float)atof(argv[i]);
-            i++;
-            assert(i < argc);
-            depthMax = (float)atof(argv[i]);
-            i++;
-            assert(i < argc);
-            depthFile = argv[i];
-        } else if (!strcmp(argv[i], "-normals")) {
-            i++;
-            assert(i < argc);
-            normalsFile = argv[i];
-        } else if (!strcmp(argv[i], "-bounces")) {
-            i++;
-            assert(i < argc);
-            bounces = atoi(argv[i]);
-        } else if (!strcmp(argv[i], "-shadows")) {
-            shadows = true;
-        } else if (strcmp(argv[i], "-jitter") == 0) {
-            jitter = true;
-        } else if (strcmp(argv[i], "-filter") == 0) {
-            filter = true;
-        } else if (strcmp(argv[i], "-casting") == 0) {
-            rayCasting = true;
-        } else if (!strcmp(argv[i], "-blurry")) {
-            blurry = true;
-            focus_dist = atof(argv[++i]);
-        } else if (strcmp(argv[i], "-pixelated") == 0) {
-            pixelated = true;
-        } else if (strcmp(argv[i], "-noargs") == 0) {
-            exit(0);
-        } else {
-            printf("Unknown command line argument %d: '%s'\n", i, argv[i]);
-            assert(0);
-        }
-    }
-}
+#include "Arguments.h"
+#include "Stats.h"
+#include <cstdarg>
+
+///@brief sets error to the message of format, as printf does
+///@return false, the result of the failed parse
+static bool fail(std::string &error, const char *format, ...) {
+    char message[256];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+    error = message;
+    return false;
+}
+
+// moves i to the next operand of the option flag, failing the parse
+// when the command line ends before it
+#define NEXT_OPERAND()                                                                                                 \
+    if (++i >= argc) {                                                                                                 \
+        return fail(error, "Missing operand of %s", flag);                                                             \
+    }
+
+Arguments::Arguments(int argc, const char **argv) {
+    std::string error;
+    if (!parse(argc, argv, error)) {
+        printf("%s\n", error.c_str());
+        assert(0);
+    }
+}
+
+bool Arguments::parse(int argc, const char **argv, std::string &error) {
+    // argv[0] is the name of the executable
+    for (int i = 1; i < argc; ++i) {
+        const char *flag = argv[i];
+        if (!strcmp(argv[i], "-input")) {
+            NEXT_OPERAND();
+            inputFile = argv[i];
+        } else if (!strcmp(argv[i], "-output")) {
+            NEXT_OPERAND();
+            outputFile = argv[i];
+        } else if (!strcmp(argv[i], "-size")) {
+            NEXT_OPERAND();
+            width = atoi(argv[i]); 
+            NEXT_OPERAND();
+            height = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-depth")) {
+            NEXT_OPERAND();
+            depthMin = (float)atof(argv[i]);
+            NEXT_OPERAND();
+            depthMax = (float)atof(argv[i]);
+            NEXT_OPERAND();
+            aovFiles[AOV_DEPTH] = argv[i];
+        } else if (!strcmp(argv[i], "-normals")) {
+            NEXT_OPERAND();
+            aovFiles[AOV_NORMALS] = argv[i];
+        } else if (!strcmp(argv[i], "-cost")) {
+            NEXT_OPERAND();
+            if (!strcmp(argv[i], "steps")) {
+                costSteps = true;
+                if (!RenderStats::enabled()) {
+                    return fail(error, "Cost in steps needs the statistics, rebuild with make clean && make STATS=1");
+                }
+            } else if (strcmp(argv[i], "cycles") != 0) {
+                return fail(error, "Unknown cost '%s'", argv[i]);
+            }
+            NEXT_OPERAND();
+            aovFiles[AOV_COST] = argv[i];
+        } else if (!strcmp(argv[i], "-aov")) {
+            NEXT_OPERAND();
+            Aov aov = aovFromName(argv[i]);
+            if (aov == NUM_AOVS) {
+                return fail(error, "Unknown aov '%s'", argv[i]);
+            }
+            NEXT_OPERAND();
+            aovFiles[aov] = argv[i];
+        } else if (!strcmp(argv[i], "-bounces")) {
+            NEXT_OPERAND();
+            bounces = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-shadows")) {
+            shadows = true;
+        } else if (!strcmp(argv[i], "-shadow-coherence")) {
+            shadowCoherence = true;
+        } else if (!strcmp(argv[i], "-light-cull")) {
+            NEXT_OPERAND();
+            lightCull = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-light-samples")) {
+            NEXT_OPERAND();
+            lightSamples = atoi(argv[i]);
+        } else if (strcmp(argv[i], "-jitter") == 0) {
+            jitter = true;
+        } else if (strcmp(argv[i], "-filter") == 0) {
+            filter = true;
+        } else if (!strcmp(argv[i], "-filter-kernel")) {
+            filter = true;
+            NEXT_OPERAND();
+            filterKernel = Smoothing::fromName(argv[i]);
+            if (filterKernel == NUM_FILTERS) {
+                return fail(error, "Unknown filter kernel '%s'", argv[i]);
+            }
+            NEXT_OPERAND();
+            filterRadius = (float)atof(argv[i]);
+            if (filterRadius <= 0) {
+                return fail(error, "The filter radius must be positive");
+            }
+        } else if (!strcmp(argv[i], "-adaptive")) {
+            adaptive = true;
+            // the threshold and the max samples are optional, in order
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                adaptiveThreshold = (float)atof(argv[++i]);
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    adaptiveMaxSamples = atoi(argv[++i]);
+                }
+            }
+        } else if (strcmp(argv[i], "-denoise") == 0) {
+            denoise = true;
+        } else if (!strcmp(argv[i], "-reference")) {
+            NEXT_OPERAND();
+            referenceFile = argv[i];
+        } else if (!strcmp(argv[i], "-spp")) {
+            NEXT_OPERAND();
+            spp = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-time-budget")) {
+            NEXT_OPERAND();
+            timeBudget = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-threads")) {
+            NEXT_OPERAND();
+            threads = atoi(argv[i]);
+            if (threads < 0) {
+                return fail(error, "The number of threads must not be negative");
+            }
+        } else if (strcmp(argv[i], "-casting") == 0) {
+            rayCasting = true;
+        } else if (!strcmp(argv[i], "-blurry")) {
+            blurry = true;
+            NEXT_OPERAND();
+            focus_dist = atof(argv[i]);
+        } else if (!strcmp(argv[i], "-lens-samples")) {
+            NEXT_OPERAND();
+            lensSamplesMin = atoi(argv[i]);
+            NEXT_OPERAND();
+            lensSamplesMax = atoi(argv[i]);
+            if (lensSamplesMin < 1 || lensSamplesMax < lensSamplesMin) {
+                return fail(error, "The lens samples must be at least 1, the max at least the min");
+            }
+        } else if (strcmp(argv[i], "-pixelated") == 0) {
+            pixelated = true;
+        } else if (!strcmp(argv[i], "-trace")) {
+            NEXT_OPERAND();
+            traceFile = argv[i];
+        } else if (!strcmp(argv[i], "-stats")) {
+            stats = true;
+        } else if (!strcmp(argv[i], "-tonemap")) {
+            toneMap = true;
+            NEXT_OPERAND();
+            toneMapOperator = ToneMapping::fromName(argv[i]);
+            if (toneMapOperator == NUM_TONEMAPS) {
+                return fail(error, "Unknown tone mapping operator '%s'", argv[i]);
+            }
+            NEXT_OPERAND();
+            exposure = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-server")) {
+            server = true;
+        } else if (!strcmp(argv[i], "-socket")) {
+            server = true;
+            NEXT_OPERAND();
+            socketFile = argv[i];
+        } else if (!strcmp(argv[i], "-frames")) {
+            NEXT_OPERAND();
+            framesFile = argv[i];
+        } else if (!strcmp(argv[i], "-reproject")) {
+            reproject = true;
+            NEXT_OPERAND();
+            refreshFraction = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-jobs")) {
+            NEXT_OPERAND();
+            jobsFile = argv[i];
+        } else if (!strcmp(argv[i], "-bench")) {
+            NEXT_OPERAND();
+            benchReps = atoi(argv[i]);
+            if (benchReps <= 0) {
+                return fail(error, "The benchmark repetitions must be positive");
+            }
+        } else if (!strcmp(argv[i], "-microbench")) {
+            NEXT_OPERAND();
+            microbenchRays = atoi(argv[i]);
+            if (microbenchRays <= 0) {
+                return fail(error, "The microbenchmark rays must be positive");
+            }
+        } else if (!strcmp(argv[i], "-bench-output")) {
+            NEXT_OPERAND();
+            benchOutput = argv[i];
+        } else if (!strcmp(argv[i], "-bench-baseline")) {
+            NEXT_OPERAND();
+            benchBaseline = argv[i];
+        } else if (!strcmp(argv[i], "-bench-tolerance")) {
+            NEXT_OPERAND();
+            benchTolerance = (float)atof(argv[i]);
+        } else if (strcmp(argv[i], "-noargs") == 0) {
+            noArgs = true;
+            return true;
+        } else {
+            return fail(error, "Unknown command line argument %d: '%s'", i, argv[i]);
+        }
+    }
+    // without a filter the jittered image keeps its 3x3 samples per
+    // pixel, while the normals and depths are recorded per pixel
+    if (denoise && jitter && !filter && !adaptive && !progressive()) {
+        return fail(error, "-denoise with -jitter needs -filter, -adaptive or -spp");
+    }
+    return true;
+}
+
+#undef NEXT_OPERAND
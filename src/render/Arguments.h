@@ -1,14 +1,30 @@
 #ifndef ARGUMENTS_H
 #define ARGUMENTS_H
 
+#include "Aov.h"
+#include "Smoothing.h"
+#include "ToneMapping.h"
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
 
 struct Arguments {
-    Arguments() = delete;
+    ///@brief the defaults, to parse a command line into
+    Arguments() {}
+    ///@brief the options of the command line, a malformed one fails an
+    /// assertion after printing what is wrong
     Arguments(int argc, const char **argv);
+    ///@brief sets the options of argv, from argv[1] on, over the current
+    /// ones without printing anything
+    ///@param error set to what is wrong with the command line
+    ///@return false if it is malformed, the options are then partly set
+    bool parse(int argc, const char **argv, std::string &error);
+
+    // -noargs, the command line stops there and nothing is run
+    bool noArgs = false;
+
 
     const char *inputFile = NULL;
     const char *outputFile = NULL;
@@ -17,29 +33,100 @@ struct Arguments {
     int width = 100;
     int height = 100;
 
-    // depth map
-    const char *depthFile = NULL;
+    // arbitrary output variables, rendered along with the color,
+    // -depth and -normals are shorthands for two of them
+    const char *aovFiles[NUM_AOVS] = {};
     float depthMin = 0;
     float depthMax = 1;
-
-    // normals map
-    const char *normalsFile = NULL;
+    // the cost aov in traversal steps instead of cycles, make STATS=1
+    bool costSteps = false;
+    bool hasAovs() const {
+        for (auto file : aovFiles) {
+            if (file != NULL) {
+                return true;
+            }
+        }
+        return false;
+    }
 
     // raytracing
     int bounces = 4;
     bool shadows = false;
+    bool shadowCoherence = false;
+
+    // many lights
+    float lightCull = 0;
+    int lightSamples = 0;
 
     // supersampling
     bool jitter = false;
     bool filter = false;
+    // reconstruction filter of -filter, the default 5 taps without a radius
+    FilterKernel filterKernel = FILTER_GAUSSIAN;
+    float filterRadius = 0;
+    bool adaptive = false;
+    float adaptiveThreshold = 0.05;
+    int adaptiveMaxSamples = 16;
+
+    // denoising guided by the normals and depth of the primary hits
+    bool denoise = false;
+    // image to print the PSNR of the color output against
+    const char *referenceFile = NULL;
+
+    // progressive rendering
+    int spp = 0;
+    int timeBudget = 0;
+    bool progressive() const {
+        return spp > 0 || timeBudget > 0;
+    }
 
     bool rayCasting = false;
 
+    // threads rendering the tiles, 0 for one per hardware thread
+    int threads = 1;
+
     // blurring
     bool blurry = false;
     float focus_dist = 0;
+    // lens samples per pixel, from in focus to the most defocused
+    int lensSamplesMin = 1;
+    int lensSamplesMax = 32;
 
     bool pixelated = false;
+
+    // prints the counters of render statistics, compiled in with
+    // make STATS=1
+    bool stats = false;
+    // timeline of the load and render phases, as a Chrome trace
+    const char *traceFile = NULL;
+
+    // tone mapping of 8-bit color outputs, float outputs are left as
+    // they are and can be tone mapped later with a .pfm input
+    bool toneMap = false;
+    ToneMapOperator toneMapOperator = TONEMAP_CLAMP;
+    float exposure = 0;
+
+    // render server, reads jobs from stdin or from a Unix socket
+    bool server = false;
+    const char *socketFile = NULL;
+    // render jobs, one per line, against the scenes of one process
+    const char *jobsFile = NULL;
+    // animation, scene updates and frames to render
+    const char *framesFile = NULL;
+    // reuse of the previous frame, with a fraction of the pixels
+    // traced again in every frame
+    bool reproject = false;
+    float refreshFraction = 0.1;
+
+    // benchmark over the default scenes, repeated benchReps times, with
+    // a report compared against a saved one when benchBaseline is set
+    int benchReps = 0;
+    const char *benchOutput = NULL;
+    const char *benchBaseline = NULL;
+    // slowdown of the median time flagged as a regression
+    float benchTolerance = 0.1;
+    // rays per workload of the intersection kernel microbenchmark
+    int microbenchRays = 0;
 };
 
 #endif // ARGUMENTS_H
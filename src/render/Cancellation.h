@@ -0,0 +1,24 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+
+///@brief lets another thread, a signal handler or a progress callback
+/// stop a render; the renderer checks it between tiles
+class CancellationToken {
+public:
+    void cancel() {
+        cancelled.store(true);
+    }
+    void reset() {
+        cancelled.store(false);
+    }
+    bool isCancelled() const {
+        return cancelled.load();
+    }
+
+private:
+    std::atomic<bool> cancelled{false};
+};
+
+#endif // CANCELLATION_H
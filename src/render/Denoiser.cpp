@@ -0,0 +1,139 @@
+#include "Denoiser.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+// depth of the pixels without a hit, and of the padding columns around
+// the rows, which gets no weight next to anything else
+#define BACKGROUND_DEPTH 1e10f
+#define PADDING_DEPTH -1e10f
+
+void Denoiser::atrous(Image &img, const AovBuffers &aovs, const DenoiseSettings &settings) {
+    TRACE_SCOPE("denoise");
+    int w = aovs.getWidth(), h = aovs.getHeight();
+    assert(img.getSampledWidth() == w && img.getSampledHeight() == h);
+    // rows padded on both sides by the reach of the widest step, and to
+    // a multiple of 4 pixels, so that the taps never need clamping
+    int pad = 2 << (settings.iterations - 1);
+    pad = (pad + 3) / 4 * 4;
+    int stride = pad + (w + 3) / 4 * 4 + pad;
+    int size = stride * h;
+
+    // planar copies of the color, normals and depth, with the variance
+    // of the luminance filtered along with the color
+    vector<float> color[2][3], variance[2], normal[3], depth(size, PADDING_DEPTH);
+    for (int c = 0; c < 3; ++c) {
+        color[0][c].assign(size, 0);
+        color[1][c].assign(size, 0);
+        normal[c].assign(size, 0);
+    }
+    variance[0].assign(size, 0);
+    variance[1].assign(size, 0);
+    vector<Vector3f> row(img.getSampledWidth());
+    for (int y = 0; y < h; ++y) {
+        img.getSampledRow(y, row.data());
+        for (int x = 0; x < w; ++x) {
+            int i = y * stride + pad + x;
+            const AovSample &sample = aovs.at(x, y);
+            for (int c = 0; c < 3; ++c) {
+                color[0][c][i] = row[x][c];
+                normal[c][i] = sample.hit ? sample.normal[c] : 0;
+            }
+            depth[i] = sample.hit ? sample.depth : BACKGROUND_DEPTH;
+        }
+    }
+    // with a single color per pixel, the variance is estimated from the
+    // 3x3 neighborhood
+    auto luminance = [&](int i) {
+        return 0.2126f * color[0][0][i] + 0.7152f * color[0][1][i] + 0.0722f * color[0][2][i];
+    };
+    parallelFor(0, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < w; ++x) {
+                float sum = 0, sumSquared = 0;
+                int n = 0;
+                for (int sy = max(0, y - 1); sy <= min(h - 1, y + 1); ++sy) {
+                    for (int sx = max(0, x - 1); sx <= min(w - 1, x + 1); ++sx) {
+                        float l = luminance(sy * stride + pad + sx);
+                        sum += l;
+                        sumSquared += l * l;
+                        ++n;
+                    }
+                }
+                variance[0][y * stride + pad + x] = max(0.0f, sumSquared / n - (sum / n) * (sum / n));
+            }
+        }
+    });
+
+    // B3 spline, taps spread 2^iteration pixels apart
+    static const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+    const Float4 zero = Float4::broadcast(0);
+    const Float4 lr = Float4::broadcast(0.2126f), lg = Float4::broadcast(0.7152f), lb = Float4::broadcast(0.0722f);
+    const Float4 invNormal = Float4::broadcast(1 / (settings.sigmaNormal * settings.sigmaNormal));
+    const Float4 invDepth = Float4::broadcast(1 / settings.sigmaDepth);
+    const Float4 sigmaLuminance = Float4::broadcast(settings.sigmaLuminance);
+    for (int it = 0; it < settings.iterations; ++it) {
+        int step = 1 << it;
+        const vector<float> *in = color[it % 2], &inVariance = variance[it % 2];
+        vector<float> *out = color[(it + 1) % 2], &outVariance = variance[(it + 1) % 2];
+        parallelFor(0, h, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = 0; x < w; x += 4) {
+                    int i = y * stride + pad + x;
+                    Float4 ni[3], acc[3];
+                    for (int c = 0; c < 3; ++c) {
+                        ni[c] = Float4::load(&normal[c][i]);
+                        acc[c] = zero;
+                    }
+                    Float4 li = lr * Float4::load(&in[0][i]) + lg * Float4::load(&in[1][i]) + lb * Float4::load(&in[2][i]);
+                    Float4 invLuminance = Float4::broadcast(1) /
+                                          (sigmaLuminance * Float4::sqrt(Float4::load(&inVariance[i])) + Float4::broadcast(1e-4f));
+                    Float4 zi = Float4::load(&depth[i]);
+                    Float4 depthScale = invDepth / zi;
+                    Float4 weightSum = zero, varianceSum = zero;
+                    for (int ky = 0; ky < 5; ++ky) {
+                        int sy = y + (ky - 2) * step;
+                        if (sy < 0 || sy >= h) {
+                            continue;
+                        }
+                        for (int kx = 0; kx < 5; ++kx) {
+                            int j = sy * stride + pad + x + (kx - 2) * step;
+                            Float4 cj[3], normalDistance = zero;
+                            for (int c = 0; c < 3; ++c) {
+                                cj[c] = Float4::load(&in[c][j]);
+                                Float4 dn = ni[c] - Float4::load(&normal[c][j]);
+                                normalDistance = normalDistance + dn * dn;
+                            }
+                            Float4 lj = lr * cj[0] + lg * cj[1] + lb * cj[2];
+                            Float4 dz = (zi - Float4::load(&depth[j])) * depthScale;
+                            Float4 e = Float4::abs(li - lj) * invLuminance + normalDistance * invNormal + dz * dz;
+                            Float4 weight = Float4::broadcast(kernel[ky] * kernel[kx]) * Float4::exp(zero - e);
+                            for (int c = 0; c < 3; ++c) {
+                                acc[c] = acc[c] + weight * cj[c];
+                            }
+                            weightSum = weightSum + weight;
+                            varianceSum = varianceSum + weight * weight * Float4::load(&inVariance[j]);
+                        }
+                    }
+                    // the pixel itself always has weight, weightSum > 0
+                    for (int c = 0; c < 3; ++c) {
+                        (acc[c] / weightSum).store(&out[c][i]);
+                    }
+                    (varianceSum / (weightSum * weightSum)).store(&outVariance[i]);
+                }
+            }
+        });
+    }
+
+    const vector<float> *result = color[settings.iterations % 2];
+    img.reset(w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int i = y * stride + pad + x;
+            img.setPixel(x, y, Vector3f(result[0][i], result[1][i], result[2][i]));
+        }
+    }
+}
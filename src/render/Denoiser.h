@@ -0,0 +1,29 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "Aov.h"
+#include "Image.h"
+
+///@brief edge-stopping parameters of the denoiser, a neighbor's weight
+/// falls off with exp(-d / (sigma * stddev)) of its luminance difference
+/// d to the pixel, and with exp(-d^2 / sigma^2) of the other differences
+struct DenoiseSettings {
+    int iterations = 4;
+    // scales the standard deviation of the luminance of the pixel
+    float sigmaLuminance = 4;
+    // distance between the unit normals
+    float sigmaNormal = 0.3;
+    // depth difference relative to the depth of the pixel
+    float sigmaDepth = 0.02;
+};
+
+class Denoiser {
+public:
+    ///@brief edge-avoiding a-trous wavelet filter of img (resolved to the
+    /// size of aovs first if it is supersampled), guided by the normals
+    /// and depth of the primary hits in aovs and by the local variance of
+    /// the luminance; rows run in parallel and four pixels at a time
+    static void atrous(Image &img, const AovBuffers &aovs, const DenoiseSettings &settings = DenoiseSettings());
+};
+
+#endif // DENOISER_H
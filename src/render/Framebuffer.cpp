@@ -0,0 +1,136 @@
+#include "Framebuffer.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+void TileSamples::clear() {
+    memset(this, 0, sizeof(TileSamples));
+}
+
+Framebuffer::Framebuffer(int w, int h, bool variance)
+    : width(w), height(h), tilesX((w + TILE_SIZE - 1) / TILE_SIZE),
+      tiles(tilesX * ((h + TILE_SIZE - 1) / TILE_SIZE)) {
+    memset((void *)tiles.data(), 0, tiles.size() * sizeof(TileSums));
+    if (variance) {
+        squares.resize(tiles.size());
+        memset((void *)squares.data(), 0, squares.size() * sizeof(TileSquares));
+    }
+}
+
+Framebuffer::Framebuffer(Image &img)
+    : width(img.getWidth()), height(img.getHeight()), tilesX((width + TILE_SIZE - 1) / TILE_SIZE),
+      image(&img) {}
+
+Vector3f Framebuffer::getMean(int x, int y) const {
+    if (image != NULL) {
+        return image->getPixel(x, y);
+    }
+    const TileSums &tile = tiles[tileIndex(x, y)];
+    int i = pixelIndex(x, y);
+    int n = tile.count[i];
+    if (n == 0) {
+        return Vector3f::ZERO;
+    }
+    return Vector3f(tile.sum[0][i], tile.sum[1][i], tile.sum[2][i]) / n;
+}
+
+float Framebuffer::getError(int x, int y) const {
+    assert(!squares.empty());
+    const TileSums &tile = tiles[tileIndex(x, y)];
+    const TileSquares &square = squares[tileIndex(x, y)];
+    int i = pixelIndex(x, y);
+    int n = tile.count[i];
+    if (n < 2) {
+        return 0;
+    }
+    float error = 0;
+    for (int c = 0; c < 3; ++c) {
+        float mean = tile.sum[c][i] / n;
+        float variance = max(0.0f, square.sumSquared[c][i] / n - mean * mean);
+        error = max(error, sqrt(variance / n));
+    }
+    return error;
+}
+
+float Framebuffer::getContrast(int x, int y) const {
+    static const int dx[4] = {-1, 1, 0, 0}, dy[4] = {0, 0, -1, 1};
+    Vector3f mean = getMean(x, y);
+    float contrast = 0;
+    for (int k = 0; k < 4; ++k) {
+        int nx = x + dx[k], ny = y + dy[k];
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height) {
+            continue;
+        }
+        Vector3f d = getMean(nx, ny) - mean;
+        for (int c = 0; c < 3; ++c) {
+            contrast = max(contrast, fabsf(d[c]));
+        }
+    }
+    return contrast;
+}
+
+void Framebuffer::merge(int x0, int y0, const TileSamples &tile, bool replace) {
+    if (image != NULL) {
+        int x1 = min(x0 + TILE_SIZE, width), y1 = min(y0 + TILE_SIZE, height);
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                int i = pixelIndex(x, y);
+                if (tile.count[i] > 0) {
+                    image->setPixel(x, y, Vector3f(tile.sum[0][i], tile.sum[1][i], tile.sum[2][i]) / tile.count[i]);
+                }
+            }
+        }
+        return;
+    }
+    TileSums &dst = tiles[tileIndex(x0, y0)];
+    TileSquares *squared = squares.empty() ? NULL : &squares[tileIndex(x0, y0)];
+    if (replace) {
+        for (int i = 0; i < TILE_PIXELS; ++i) {
+            if (tile.count[i] > 0) {
+                for (int c = 0; c < 3; ++c) {
+                    dst.sum[c][i] = tile.sum[c][i];
+                    if (squared != NULL) {
+                        squared->sumSquared[c][i] = tile.sumSquared[c][i];
+                    }
+                }
+                dst.count[i] = tile.count[i];
+            }
+        }
+        return;
+    }
+    // plain loops over the planes, which the compiler vectorizes
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < TILE_PIXELS; ++i) {
+            dst.sum[c][i] += tile.sum[c][i];
+        }
+    }
+    if (squared != NULL) {
+        for (int c = 0; c < 3; ++c) {
+            for (int i = 0; i < TILE_PIXELS; ++i) {
+                squared->sumSquared[c][i] += tile.sumSquared[c][i];
+            }
+        }
+    }
+    for (int i = 0; i < TILE_PIXELS; ++i) {
+        dst.count[i] += tile.count[i];
+    }
+}
+
+void Framebuffer::resolve(Image &img) const {
+    if (image != NULL) {
+        assert(&img == image);
+        return;
+    }
+    TRACE_SCOPE("resolve");
+    img.reset(width, height);
+    parallelFor(0, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < width; ++x) {
+                img.setPixel(x, y, getMean(x, y));
+            }
+        }
+    });
+}
@@ -0,0 +1,103 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "Image.h"
+#include <vecmath.h>
+#include <vector>
+
+// all renderers go through the image in square tiles, a cancelled
+// render stops after the tile in progress
+#define TILE_SIZE 32
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+
+///@brief the samples of one tile, with planar channels and the pixels
+/// row-major in the tile; aligned so that two tiles, in a Framebuffer or
+/// rendered by two threads, never share a cache line
+struct alignas(64) TileSamples {
+    float sum[3][TILE_PIXELS];
+    float sumSquared[3][TILE_PIXELS];
+    int count[TILE_PIXELS];
+
+    void clear();
+    ///@param i pixel index in the tile, y * TILE_SIZE + x
+    void addSample(int i, const Vector3f &color) {
+        for (int c = 0; c < 3; ++c) {
+            sum[c][i] += color[c];
+            sumSquared[c][i] += color[c] * color[c];
+        }
+        ++count[i];
+    }
+};
+
+///@brief per-pixel accumulation of samples, a renderer fills a
+/// tile-local TileSamples and merges it once
+///
+/// it keeps the running sum and the sample count of every pixel in
+/// row-major tiles, and the sum of squares only when asked to, since
+/// only adaptive sampling reads it; single samples need neither and go
+/// straight into the image
+class Framebuffer {
+public:
+    ///@param variance keeps the sums of squares for getError
+    Framebuffer(int w, int h, bool variance = false);
+    ///@brief a framebuffer of one sample per pixel, which merge writes
+    /// straight into img, at its size; merging a pixel again replaces it
+    explicit Framebuffer(Image &img);
+    Framebuffer(const Framebuffer &) = delete;
+    Framebuffer(Framebuffer &&) = default;
+    Framebuffer &operator=(const Framebuffer &) = delete;
+    Framebuffer &operator=(Framebuffer &&) = default;
+
+    int getWidth() const {
+        return width;
+    }
+    int getHeight() const {
+        return height;
+    }
+    int getCount(int x, int y) const {
+        if (image != NULL) {
+            return 1;
+        }
+        return tiles[tileIndex(x, y)].count[pixelIndex(x, y)];
+    }
+    Vector3f getMean(int x, int y) const;
+    ///@brief largest per-channel standard error of the mean, needs variance
+    float getError(int x, int y) const;
+    ///@brief largest per-channel difference to the 4-neighbors' means
+    float getContrast(int x, int y) const;
+
+    ///@brief adds the samples of the tile whose top left pixel is (x0, y0),
+    /// or with replace, overwrites the pixels the tile has samples of
+    void merge(int x0, int y0, const TileSamples &tile, bool replace = false);
+    ///@brief writes the mean of every pixel into img, a framebuffer of
+    /// single samples has them there already
+    void resolve(Image &img) const;
+
+private:
+    int width;
+    int height;
+    int tilesX;
+
+    // the sums and counts of a tile, and its sums of squares
+    struct alignas(64) TileSums {
+        float sum[3][TILE_PIXELS];
+        int count[TILE_PIXELS];
+    };
+    struct alignas(64) TileSquares {
+        float sumSquared[3][TILE_PIXELS];
+    };
+    std::vector<TileSums> tiles;
+    // empty without variance
+    std::vector<TileSquares> squares;
+    // where single samples go, NULL for the sums
+    Image *image = NULL;
+
+    int tileIndex(int x, int y) const {
+        return y / TILE_SIZE * tilesX + x / TILE_SIZE;
+    }
+    static int pixelIndex(int x, int y) {
+        return y % TILE_SIZE * TILE_SIZE + x % TILE_SIZE;
+    }
+};
+
+#endif // FRAMEBUFFER_H
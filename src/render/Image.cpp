@@ -1,7 +1,14 @@
 #include "Image.h"
+#include "Parallel.h"
+#include "Png.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 Vector3f Image::getSampledPixel(int x, int y) const {
     if (samplingRate == 1)
@@ -22,20 +29,82 @@ Vector3f Image::getSampledPixel(int x, int y) const {
     return res / size;
 }
 
+void Image::getSampledRow(int y, Vector3f *row) const {
+    int w = getSampledWidth();
+    assert(y >= 0 && y < getSampledHeight());
+    if (samplingRate == 1) {
+        std::copy(data + y * width, data + (y + 1) * width, row);
+        return;
+    }
+    int sy0 = sampled(y), sy1 = sampled(y + 1);
+    for (int x = 0; x < w; ++x) {
+        int sx0 = sampled(x), sx1 = sampled(x + 1);
+        Vector3f sum;
+        // same summation order as getSampledPixel
+        for (int i = sx0; i < sx1; ++i) {
+            for (int j = sy0; j < sy1; ++j) {
+                sum += data[j * width + i];
+            }
+        }
+        row[x] = sum / ((sx1 - sx0) * (sy1 - sy0));
+    }
+}
+
+void Image::toBytes(unsigned char *out, int rowBytes, bool bgr, bool topFirst) const {
+    int width = getSampledWidth(), height = getSampledHeight();
+    parallelFor(0, height, [&](int y0, int y1) {
+        std::vector<Vector3f> row(width);
+        for (int y = y0; y < y1; ++y) {
+            getSampledRow(y, row.data());
+            unsigned char *line = out + (topFirst ? height - 1 - y : y) * rowBytes;
+            clampToBytes((const float *)row.data(), line, 3 * width);
+            if (bgr) {
+                for (int x = 0; x < width; ++x) {
+                    std::swap(line[3 * x], line[3 * x + 2]);
+                }
+            }
+        }
+    });
+}
+
+void Image::toRgba(unsigned char *out) const {
+    int width = getSampledWidth(), height = getSampledHeight();
+    toBytes(out, 4 * width, false, true);
+    // spread the rgb of every row over 4 bytes per pixel, from the right
+    // so that nothing is overwritten before it is moved
+    parallelFor(0, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            unsigned char *line = out + y * 4 * width;
+            for (int x = width - 1; x >= 0; --x) {
+                line[4 * x + 3] = 255;
+                line[4 * x + 2] = line[3 * x + 2];
+                line[4 * x + 1] = line[3 * x + 1];
+                line[4 * x] = line[3 * x];
+            }
+        }
+    });
+}
+
 // some helper functions for save & load
 
-unsigned char ReadByte(FILE *file) {
+///@brief writes the whole file at once
+static bool writeFile(const char *filename, const std::vector<unsigned char> &buf) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool success = fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+    fclose(file);
+    return success;
+}
+
+static unsigned char ReadByte(FILE *file) {
     unsigned char b;
     int success = fread((void *)(&b), sizeof(unsigned char), 1, file);
     assert(success == 1);
     return b;
 }
 
-void WriteByte(FILE *file, unsigned char b) {
-    int success = fwrite((void *)(&b), sizeof(unsigned char), 1, file);
-    assert(success == 1);
-}
-
 unsigned char ClampColorComponent(float c) {
     int tmp = int(c * 255);
 
@@ -53,44 +122,25 @@ unsigned char ClampColorComponent(float c) {
 // Save and Load data type 2 Targa (.tga) files
 // (uncompressed, unmapped RGB images)
 
-void Image::saveTga(const char *filename) const {
+int Image::saveTga(const char *filename) const {
     int width = getSampledWidth(), height = getSampledHeight();
     assert(filename != NULL);
     // must end in .tga
     const char *ext = &filename[strlen(filename) - 4];
     assert(!strcmp(ext, ".tga"));
-    FILE *file = fopen(filename, "wb");
+    std::vector<unsigned char> buf(18 + 3 * width * height, 0);
     // misc header information
-    for (int i = 0; i < 18; i++) {
-        if (i == 2)
-            WriteByte(file, 2);
-        else if (i == 12)
-            WriteByte(file, width % 256);
-        else if (i == 13)
-            WriteByte(file, width / 256);
-        else if (i == 14)
-            WriteByte(file, height % 256);
-        else if (i == 15)
-            WriteByte(file, height / 256);
-        else if (i == 16)
-            WriteByte(file, 24);
-        else if (i == 17)
-            WriteByte(file, 32);
-        else
-            WriteByte(file, 0);
-    }
-    // the data
+    buf[2] = 2;
+    buf[12] = width % 256;
+    buf[13] = width / 256;
+    buf[14] = height % 256;
+    buf[15] = height / 256;
+    buf[16] = 24;
+    buf[17] = 32;
+    // the data, b, g, r
     // flip y so that (0,0) is bottom left corner
-    for (int y = height - 1; y >= 0; y--) {
-        for (int x = 0; x < width; x++) {
-            Vector3f v = getSampledPixel(x, y);
-            // note reversed order: b, g, r
-            WriteByte(file, ClampColorComponent(v[2]));
-            WriteByte(file, ClampColorComponent(v[1]));
-            WriteByte(file, ClampColorComponent(v[0]));
-        }
-    }
-    fclose(file);
+    toBytes(buf.data() + 18, 3 * width, true, true);
+    return writeFile(filename, buf);
 }
 
 Image *Image::loadTga(const char *filename) {
@@ -99,6 +149,9 @@ Image *Image::loadTga(const char *filename) {
     const char *ext = &filename[strlen(filename) - 4];
     assert(!strcmp(ext, ".tga"));
     FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
     // misc header information
     int width = 0;
     int height = 0;
@@ -143,30 +196,21 @@ Image *Image::loadTga(const char *filename) {
 // Save and Load PPM image files using magic number 'P6'
 // and having one comment line
 
-void Image::savePpm(const char *filename) const {
+int Image::savePpm(const char *filename) const {
     int width = getSampledWidth(), height = getSampledHeight();
     assert(filename != NULL);
     // must end in .ppm
     const char *ext = &filename[strlen(filename) - 4];
     assert(!strcmp(ext, ".ppm"));
-    FILE *file = fopen(filename, "w");
     // misc header information
-    assert(file != NULL);
-    fprintf(file, "P6\n");
-    fprintf(file, "# Creator: Image::SavePPM()\n");
-    fprintf(file, "%d %d\n", width, height);
-    fprintf(file, "255\n");
+    char header[100];
+    int headerSize = snprintf(header, sizeof(header), "P6\n# Creator: Image::SavePPM()\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> buf(headerSize + 3 * width * height);
+    memcpy(buf.data(), header, headerSize);
     // the data
     // flip y so that (0,0) is bottom left corner
-    for (int y = height - 1; y >= 0; y--) {
-        for (int x = 0; x < width; x++) {
-            Vector3f v = getSampledPixel(x, y);
-            fputc(ClampColorComponent(v[0]), file);
-            fputc(ClampColorComponent(v[1]), file);
-            fputc(ClampColorComponent(v[2]), file);
-        }
-    }
-    fclose(file);
+    toBytes(buf.data() + headerSize, 3 * width, false, true);
+    return writeFile(filename, buf);
 }
 
 Image *Image::loadPpm(const char *filename) {
@@ -175,6 +219,9 @@ Image *Image::loadPpm(const char *filename) {
     const char *ext = &filename[strlen(filename) - 4];
     assert(!strcmp(ext, ".ppm"));
     FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
     // misc header information
     int width = 0;
     int height = 0;
@@ -225,6 +272,25 @@ Image *Image::compare(Image *img1, Image *img2) {
 
     return img3;
 }
+float Image::psnr(const Image &img1, const Image &img2) {
+    int w = img1.getSampledWidth(), h = img1.getSampledHeight();
+    assert(img2.getSampledWidth() == w && img2.getSampledHeight() == h);
+    std::vector<Vector3f> row1(w), row2(w);
+    double error = 0;
+    for (int y = 0; y < h; ++y) {
+        img1.getSampledRow(y, row1.data());
+        img2.getSampledRow(y, row2.data());
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                double d = std::clamp(row1[x][c], 0.0f, 1.0f) - std::clamp(row2[x][c], 0.0f, 1.0f);
+                error += d * d;
+            }
+        }
+    }
+    error /= 3.0 * w * h;
+    return error > 0 ? 10 * log10(1 / error) : INFINITY;
+}
+
 /****************************************************************************
     bmp.c - read and write bmp images.
     Distributed with Xplanet.
@@ -263,12 +329,9 @@ struct BMPHeader {
     int biClrImportant;  /* Number of important colors.  If 0, all colors
                             are important */
 };
-int Image::saveBmp(const char *filename) {
+int Image::saveBmp(const char *filename) const {
     int width = getSampledWidth(), height = getSampledHeight();
-    int i, j;
     int bytesPerLine;
-    unsigned char *line;
-    FILE *file;
     struct BMPHeader bmph;
 
     /* The length of each line must be a multiple of 4 bytes */
@@ -291,54 +354,214 @@ int Image::saveBmp(const char *filename) {
     bmph.biClrUsed = 0;
     bmph.biClrImportant = 0;
 
-    file = fopen(filename, "wb");
-    if (file == NULL)
-        return (0);
+    std::vector<unsigned char> buf(bmph.bfSize, 0);
+    unsigned char *p = buf.data();
+    auto put = [&p](const void *field, int size) {
+        memcpy(p, field, size);
+        p += size;
+    };
+    put(&bmph.bfType, 2);
+    put(&bmph.bfSize, 4);
+    put(&bmph.bfReserved, 4);
+    put(&bmph.bfOffBits, 4);
+    put(&bmph.biSize, 4);
+    put(&bmph.biWidth, 4);
+    put(&bmph.biHeight, 4);
+    put(&bmph.biPlanes, 2);
+    put(&bmph.biBitCount, 2);
+    put(&bmph.biCompression, 4);
+    put(&bmph.biSizeImage, 4);
+    put(&bmph.biXPelsPerMeter, 4);
+    put(&bmph.biYPelsPerMeter, 4);
+    put(&bmph.biClrUsed, 4);
+    put(&bmph.biClrImportant, 4);
 
-    fwrite(&bmph.bfType, 2, 1, file);
-    fwrite(&bmph.bfSize, 4, 1, file);
-    fwrite(&bmph.bfReserved, 4, 1, file);
-    fwrite(&bmph.bfOffBits, 4, 1, file);
-    fwrite(&bmph.biSize, 4, 1, file);
-    fwrite(&bmph.biWidth, 4, 1, file);
-    fwrite(&bmph.biHeight, 4, 1, file);
-    fwrite(&bmph.biPlanes, 2, 1, file);
-    fwrite(&bmph.biBitCount, 2, 1, file);
-    fwrite(&bmph.biCompression, 4, 1, file);
-    fwrite(&bmph.biSizeImage, 4, 1, file);
-    fwrite(&bmph.biXPelsPerMeter, 4, 1, file);
-    fwrite(&bmph.biYPelsPerMeter, 4, 1, file);
-    fwrite(&bmph.biClrUsed, 4, 1, file);
-    fwrite(&bmph.biClrImportant, 4, 1, file);
-
-    line = (unsigned char *)malloc(bytesPerLine);
-    if (line == NULL) {
-        fprintf(stderr, "Can't allocate memory for BMP file.\n");
+    // rows bottom up, b, g, r
+    toBytes(buf.data() + bmph.bfOffBits, bytesPerLine, true, false);
+    if (!writeFile(filename, buf))
         return (0);
-    }
 
-    Vector3f pixel;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            pixel = getSampledPixel(j, i);
-            line[3 * j] = ClampColorComponent(pixel[2]);
-            line[3 * j + 1] = ClampColorComponent(pixel[1]);
-            line[3 * j + 2] = ClampColorComponent(pixel[0]);
+    return (1);
+}
+
+int Image::savePng(const char *filename) const {
+    int width = getSampledWidth(), height = getSampledHeight();
+    std::vector<unsigned char> rgb(3 * width * height), buf;
+    toBytes(rgb.data(), 3 * width, false, true);
+    Png::encode(rgb.data(), width, height, buf);
+    return writeFile(filename, buf);
+}
+
+// Save and Load Portable Float Map (.pfm) files, little endian RGB
+// floats, bottom row first like the image
+
+int Image::savePfm(const char *filename) const {
+    int width = getSampledWidth(), height = getSampledHeight();
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    // a negative scale means little endian
+    bool success = fprintf(file, "PF\n%d %d\n-1.0\n", width, height) > 0;
+    std::vector<Vector3f> row(width);
+    std::vector<float> line(3 * width);
+    for (int y = 0; y < height; y++) {
+        getSampledRow(y, row.data());
+        for (int x = 0; x < width; x++) {
+            line[3 * x] = row[x][0];
+            line[3 * x + 1] = row[x][1];
+            line[3 * x + 2] = row[x][2];
         }
-        fwrite(line, bytesPerLine, 1, file);
+        success = success && fwrite(line.data(), sizeof(float), line.size(), file) == line.size();
     }
+    return fclose(file) == 0 && success;
+}
 
-    free(line);
+Image *Image::loadPfm(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    int width = 0, height = 0;
+    float scale = 0;
+    char magic[3] = {};
+    int read = fscanf(file, "%2s %d %d %f", magic, &width, &height, &scale);
+    // a single whitespace character ends the header, and only little
+    // endian files, like the ones savePfm writes, are read
+    if (read != 4 || strcmp(magic, "PF") || width <= 0 || height <= 0 || !(scale < 0) || !isspace(fgetc(file))) {
+        fclose(file);
+        return NULL;
+    }
+    Image *answer = new Image(width, height);
+    std::vector<float> line(3 * width);
+    for (int y = 0; y < height; y++) {
+        if (fread(line.data(), sizeof(float), line.size(), file) != line.size()) {
+            fclose(file);
+            delete answer;
+            return NULL;
+        }
+        for (int x = 0; x < width; x++) {
+            answer->setPixel(x, y, Vector3f(line[3 * x], line[3 * x + 1], line[3 * x + 2]));
+        }
+    }
     fclose(file);
+    return answer;
+}
 
-    return (1);
+// OpenEXR, see "Reading and writing OpenEXR image files with the IlmImf
+// library" and "OpenEXR file layout"; everything is little endian
+
+template <typename T>
+static void WriteValue(std::vector<char> &buf, T value) {
+    const char *bytes = (const char *)&value;
+    buf.insert(buf.end(), bytes, bytes + sizeof(T));
+}
+
+static void WriteAttribute(std::vector<char> &buf, const char *name, const char *type,
+                    const std::vector<char> &value) {
+    buf.insert(buf.end(), name, name + strlen(name) + 1);
+    buf.insert(buf.end(), type, type + strlen(type) + 1);
+    WriteValue<int>(buf, value.size());
+    buf.insert(buf.end(), value.begin(), value.end());
+}
+
+int Image::saveExr(const char *filename) const {
+    int width = getSampledWidth(), height = getSampledHeight();
+    std::vector<char> header, value;
+    WriteValue<int>(header, 20000630);
+    // version 2, single part scanline file
+    WriteValue<int>(header, 2);
+
+    // channels are sorted by name, 32-bit float (type 2), not linear,
+    // no subsampling
+    for (const char *channel : {"B", "G", "R"}) {
+        value.insert(value.end(), channel, channel + 2);
+        WriteValue<int>(value, 2);
+        WriteValue<int>(value, 0);
+        WriteValue<int>(value, 1);
+        WriteValue<int>(value, 1);
+    }
+    value.push_back(0);
+    WriteAttribute(header, "channels", "chlist", value);
+    WriteAttribute(header, "compression", "compression", {0});
+    value.clear();
+    for (int v : {0, 0, width - 1, height - 1}) {
+        WriteValue<int>(value, v);
+    }
+    WriteAttribute(header, "dataWindow", "box2i", value);
+    WriteAttribute(header, "displayWindow", "box2i", value);
+    // increasing y, top row first
+    WriteAttribute(header, "lineOrder", "lineOrder", {0});
+    value.clear();
+    WriteValue<float>(value, 1);
+    WriteAttribute(header, "pixelAspectRatio", "float", value);
+    WriteAttribute(header, "screenWindowWidth", "float", value);
+    value.clear();
+    WriteValue<float>(value, 0);
+    WriteValue<float>(value, 0);
+    WriteAttribute(header, "screenWindowCenter", "v2f", value);
+    header.push_back(0);
+
+    // uncompressed, one scanline per chunk, so all offsets are known
+    int lineSize = 3 * width * sizeof(float);
+    long long offset = header.size() + (long long)height * sizeof(long long);
+    for (int y = 0; y < height; y++) {
+        WriteValue<long long>(header, offset + (long long)y * (8 + lineSize));
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    bool success = fwrite(header.data(), 1, header.size(), file) == header.size();
+    std::vector<Vector3f> row(width);
+    std::vector<float> line(3 * width);
+    for (int y = 0; y < height; y++) {
+        // the image has its bottom row first
+        getSampledRow(height - 1 - y, row.data());
+        for (int x = 0; x < width; x++) {
+            line[x] = row[x][2];
+            line[width + x] = row[x][1];
+            line[2 * width + x] = row[x][0];
+        }
+        success = success && fwrite(&y, sizeof(int), 1, file) == 1 && fwrite(&lineSize, sizeof(int), 1, file) == 1 &&
+                  fwrite(line.data(), sizeof(float), line.size(), file) == line.size();
+    }
+    return fclose(file) == 0 && success;
+}
+
+bool Image::isFloatFormat(const char *filename) {
+    int len = strlen(filename);
+    return len >= 4 && (strcmp(".pfm", filename + len - 4) == 0 || strcmp(".exr", filename + len - 4) == 0);
+}
+
+Image *Image::loadImage(const char *filename) {
+    int len = strlen(filename);
+    if (len < 4)
+        return NULL;
+    if (strcmp(".pfm", filename + len - 4) == 0)
+        return loadPfm(filename);
+    if (strcmp(".ppm", filename + len - 4) == 0)
+        return loadPpm(filename);
+    if (strcmp(".tga", filename + len - 4) == 0)
+        return loadTga(filename);
+    return NULL;
 }
 
-void Image::saveImage(const char *filename) {
+int Image::saveImage(const char *filename) const {
+    TRACE_SCOPE("save image", filename);
     int len = strlen(filename);
     if (strcmp(".bmp", filename + len - 4) == 0) {
-        saveBmp(filename);
+        return saveBmp(filename);
+    } else if (strcmp(".png", filename + len - 4) == 0) {
+        return savePng(filename);
+    } else if (strcmp(".pfm", filename + len - 4) == 0) {
+        return savePfm(filename);
+    } else if (strcmp(".exr", filename + len - 4) == 0) {
+        return saveExr(filename);
+    } else if (strcmp(".ppm", filename + len - 4) == 0) {
+        return savePpm(filename);
     } else {
-        saveTga(filename);
+        return saveTga(filename);
     }
 }
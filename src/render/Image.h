@@ -1,6 +1,7 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <vecmath.h>
@@ -18,10 +19,30 @@ private:
 public:
     Image(int w, int h)
         : width(w), height(h), data(new Vector3f[width * height]) {}
+    Image(const Image &) = delete;
+    Image(Image &&other)
+        : width(other.width), height(other.height), data(other.data), samplingRate(other.samplingRate) {
+        other.width = other.height = 0;
+        other.data = NULL;
+    }
     ~Image() {
         delete[] data;
     }
 
+    Image &operator=(const Image &) = delete;
+    Image &operator=(Image &&other) {
+        if (this != &other) {
+            delete[] data;
+            width = other.width;
+            height = other.height;
+            data = other.data;
+            samplingRate = other.samplingRate;
+            other.width = other.height = 0;
+            other.data = NULL;
+        }
+        return *this;
+    }
+
     int getWidth() const {
         return width;
     }
@@ -33,6 +54,11 @@ public:
         assert(y >= 0 && y < height);
         return data[y * width + x];
     }
+    ///@brief row y, width pixels, the next rows follow it
+    Vector3f *getRow(int y) {
+        assert(y >= 0 && y < height);
+        return data + y * width;
+    }
     int getSampledWidth() const {
         if (samplingRate == 1)
             return width;
@@ -44,15 +70,27 @@ public:
         return floor(height / samplingRate);
     }
     Vector3f getSampledPixel(int x, int y) const;
+    ///@brief row y of the sampled image, getSampledWidth() pixels
+    void getSampledRow(int y, Vector3f *row) const;
+    ///@brief converts the sampled image to 8-bit RGB, or BGR, in parallel;
+    /// row y goes to out + y * rowBytes, or from the bottom if topFirst
+    void toBytes(unsigned char *out, int rowBytes, bool bgr, bool topFirst) const;
+    ///@brief converts the sampled image to 8-bit RGBA with opaque alpha,
+    /// top row first, as a canvas takes it
+    void toRgba(unsigned char *out) const;
 
     void reset() {
         reset(width, height);
+        setAllPixels(Vector3f::ZERO);
     }
+    ///@brief keeps the pixels, not cleared, when the size is the same
     void reset(int w, int h) {
+        if (w * h != width * height) {
+            delete[] data;
+            data = new Vector3f[w * h];
+        }
         width = w;
         height = h;
-        delete[] data;
-        data = new Vector3f[width * height];
         samplingRate = 1;
     }
     void setSamplingRate(float r = 1) {
@@ -72,22 +110,35 @@ public:
     void setImage(const Image &image) {
         reset(image.width, image.height);
         samplingRate = image.samplingRate;
-        for (int i = 0; i < width; ++i) {
-            for (int j = 0; j < height; ++j) {
-                setPixel(i, j, image.getPixel(i, j));
-            }
-        }
+        std::copy(image.data, image.data + width * height, data);
     }
 
     static Image *loadPpm(const char *filename);
-    void savePpm(const char *filename) const;
+    int savePpm(const char *filename) const;
 
     static Image *loadTga(const char *filename);
-    void saveTga(const char *filename) const;
-    int saveBmp(const char *filename);
-    void saveImage(const char *filename);
+    int saveTga(const char *filename) const;
+    // the savers return 1 on success, 0 if the file cannot be written
+    int saveBmp(const char *filename) const;
+    int savePng(const char *filename) const;
+    // float formats, written without clamping
+    ///@return NULL if the file cannot be read or is not a little endian
+    /// RGB .pfm
+    static Image *loadPfm(const char *filename);
+    int savePfm(const char *filename) const;
+    ///@brief uncompressed scanline OpenEXR with 32-bit float channels
+    int saveExr(const char *filename) const;
+    ///@brief saves in the format of the extension, .bmp, .png, .pfm, .exr, or tga
+    int saveImage(const char *filename) const;
+    static bool isFloatFormat(const char *filename);
+    ///@brief loads a .pfm, .ppm or .tga file, NULL for other formats and
+    /// for files that cannot be opened
+    static Image *loadImage(const char *filename);
     // extension for image comparison
     static Image *compare(Image *img1, Image *img2);
+    ///@brief peak signal-to-noise ratio in dB of the sampled images,
+    /// clamped to [0, 1], which have to be the same size
+    static float psnr(const Image &img1, const Image &img2);
 };
 
 #endif // IMAGE_H
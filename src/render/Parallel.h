@@ -0,0 +1,45 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "Trace.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+///@brief number of threads parallelFor uses, 1 where there are none
+inline int hardwareThreads() {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    return 1;
+#else
+    return std::max(1u, std::thread::hardware_concurrency());
+#endif
+}
+
+///@brief calls body(chunkBegin, chunkEnd) on contiguous chunks of
+/// [begin, end), one chunk per thread, and waits for all of them
+inline void parallelFor(int begin, int end, std::function<void(int, int)> body,
+                        int threads = hardwareThreads()) {
+    int n = end - begin;
+    threads = std::max(1, std::min(threads, n));
+    if (threads == 1) {
+        if (n > 0) {
+            body(begin, end);
+        }
+        return;
+    }
+    auto chunk = [&body](int chunkBegin, int chunkEnd) {
+        TRACE_SCOPE("parallel chunk");
+        body(chunkBegin, chunkEnd);
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(chunk, begin + n * t / threads, begin + n * (t + 1) / threads);
+    }
+    chunk(begin, begin + n / threads);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+#endif // PARALLEL_H
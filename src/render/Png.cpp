@@ -0,0 +1,277 @@
+#include "Png.h"
+#include "Parallel.h"
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static void putBigEndian(vector<unsigned char> &out, unsigned int v) {
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+void Png::encode(const unsigned char *rgb, int width, int height, vector<unsigned char> &out) {
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    out.assign(signature, signature + 8);
+
+    vector<unsigned char> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    // 8-bit RGB, deflate, adaptive filtering, not interlaced
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    writeChunk(out, "IHDR", header.data(), header.size());
+
+    vector<unsigned char> filtered, compressed;
+    filterRows(rgb, width, height, filtered);
+    deflate(filtered, compressed);
+    // a fixed code block can be larger than the input on noisy images
+    if (compressed.size() > filtered.size()) {
+        store(filtered, compressed);
+    }
+    writeChunk(out, "IDAT", compressed.data(), compressed.size());
+    writeChunk(out, "IEND", NULL, 0);
+}
+
+unsigned int Png::crc32(const unsigned char *data, int size, unsigned int crc) {
+    static const vector<unsigned int> table = [] {
+        vector<unsigned int> t(256);
+        for (unsigned int n = 0; n < 256; ++n) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (int i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+unsigned int Png::adler32(const unsigned char *data, int size) {
+    unsigned int a = 1, b = 0;
+    while (size > 0) {
+        // largest block for which b cannot overflow
+        int n = size < 5552 ? size : 5552;
+        for (int i = 0; i < n; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+static int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+void Png::filterRows(const unsigned char *rgb, int width, int height, vector<unsigned char> &out) {
+    int rowBytes = 3 * width;
+    out.resize((rowBytes + 1) * height);
+    parallelFor(0, height, [&](int y0, int y1) {
+        vector<unsigned char> candidate(rowBytes);
+        for (int y = y0; y < y1; ++y) {
+            const unsigned char *row = rgb + y * rowBytes;
+            const unsigned char *up = y > 0 ? row - rowBytes : NULL;
+            unsigned char *dst = &out[y * (rowBytes + 1)];
+            long best = -1;
+            // 0 none, 1 sub, 2 up, 4 paeth; average rarely wins on renders
+            for (int type : {0, 1, 2, 4}) {
+                long sum = 0;
+                for (int i = 0; i < rowBytes; ++i) {
+                    int a = i >= 3 ? row[i - 3] : 0;
+                    int b = up ? up[i] : 0;
+                    int c = i >= 3 && up ? up[i - 3] : 0;
+                    int predictor = type == 0 ? 0 : type == 1 ? a : type == 2 ? b : paeth(a, b, c);
+                    candidate[i] = row[i] - predictor;
+                    sum += abs((signed char)candidate[i]);
+                }
+                if (best < 0 || sum < best) {
+                    best = sum;
+                    dst[0] = type;
+                    memcpy(dst + 1, candidate.data(), rowBytes);
+                }
+            }
+        }
+    });
+}
+
+///@brief appends bits to a deflate stream, least significant bit first
+class BitWriter {
+public:
+    BitWriter(vector<unsigned char> &o) : out(o) {}
+    void put(unsigned int value, int count) {
+        bits |= (unsigned long long)value << used;
+        used += count;
+        while (used >= 8) {
+            out.push_back(bits & 0xff);
+            bits >>= 8;
+            used -= 8;
+        }
+    }
+    ///@brief Huffman codes are stored most significant bit first
+    void putCode(unsigned int code, int count) {
+        unsigned int reversed = 0;
+        for (int i = 0; i < count; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, count);
+    }
+    void flush() {
+        if (used > 0) {
+            out.push_back(bits & 0xff);
+        }
+        bits = 0;
+        used = 0;
+    }
+
+private:
+    vector<unsigned char> &out;
+    unsigned long long bits = 0;
+    int used = 0;
+};
+
+const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                             3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                              193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                              6145, 8193, 12289, 16385, 24577};
+const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+///@brief fixed literal/length code of RFC 1951 section 3.2.6
+static void putFixedSymbol(BitWriter &writer, int symbol) {
+    if (symbol < 144)
+        writer.putCode(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer.putCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer.putCode(symbol - 256, 7);
+    else
+        writer.putCode(0xc0 + symbol - 280, 8);
+}
+
+static void putMatch(BitWriter &writer, int length, int distance) {
+    int l = 28;
+    while (lengthBase[l] > length) {
+        --l;
+    }
+    putFixedSymbol(writer, 257 + l);
+    writer.put(length - lengthBase[l], lengthExtra[l]);
+    int d = 29;
+    while (distanceBase[d] > distance) {
+        --d;
+    }
+    writer.putCode(d, 5);
+    writer.put(distance - distanceBase[d], distanceExtra[d]);
+}
+
+void Png::deflate(const vector<unsigned char> &in, vector<unsigned char> &out) {
+    const int WINDOW = 32768, MIN_MATCH = 3, MAX_MATCH = 258, MAX_CHAIN = 32;
+    const int HASH_BITS = 15;
+    out.clear();
+    out.reserve(in.size() / 2 + 64);
+    // zlib header, 32K window, fastest compression level hint
+    out.push_back(0x78);
+    out.push_back(0x01);
+    BitWriter writer(out);
+    // final block, fixed Huffman codes
+    writer.put(1, 1);
+    writer.put(1, 2);
+
+    int n = in.size();
+    vector<int> head(1 << HASH_BITS, -1), prev(WINDOW, -1);
+    auto hash = [&in](int i) {
+        unsigned int h = in[i] | (in[i + 1] << 8) | (in[i + 2] << 16);
+        return (h * 2654435761u) >> (32 - HASH_BITS);
+    };
+    auto insert = [&](int i) {
+        if (i + MIN_MATCH <= n) {
+            unsigned int h = hash(i);
+            prev[i % WINDOW] = head[h];
+            head[h] = i;
+        }
+    };
+    int i = 0;
+    while (i < n) {
+        int bestLength = 0, bestDistance = 0;
+        if (i + MIN_MATCH <= n) {
+            int limit = min(MAX_MATCH, n - i);
+            int candidate = head[hash(i)];
+            for (int chain = 0; candidate >= 0 && i - candidate <= WINDOW && chain < MAX_CHAIN; ++chain) {
+                int length = 0;
+                while (length < limit && in[candidate + length] == in[i + length]) {
+                    ++length;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                    if (length == limit)
+                        break;
+                }
+                int next = prev[candidate % WINDOW];
+                // the slot may have been reused by a newer position
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+        if (bestLength >= MIN_MATCH) {
+            putMatch(writer, bestLength, bestDistance);
+            for (int k = 0; k < bestLength; ++k) {
+                insert(i + k);
+            }
+            i += bestLength;
+        } else {
+            putFixedSymbol(writer, in[i]);
+            insert(i);
+            ++i;
+        }
+    }
+    putFixedSymbol(writer, 256);
+    writer.flush();
+    putBigEndian(out, adler32(in.data(), n));
+}
+
+void Png::store(const vector<unsigned char> &in, vector<unsigned char> &out) {
+    out.clear();
+    out.push_back(0x78);
+    out.push_back(0x01);
+    int n = in.size(), i = 0;
+    do {
+        int size = min(n - i, 65535);
+        out.push_back(i + size == n ? 1 : 0);
+        out.push_back(size & 0xff);
+        out.push_back(size >> 8);
+        out.push_back(~size & 0xff);
+        out.push_back((~size >> 8) & 0xff);
+        out.insert(out.end(), in.begin() + i, in.begin() + i + size);
+        i += size;
+    } while (i < n);
+    putBigEndian(out, adler32(in.data(), n));
+}
+
+void Png::writeChunk(vector<unsigned char> &out, const char *type, const unsigned char *data, int size) {
+    putBigEndian(out, size);
+    int start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size > 0) {
+        out.insert(out.end(), data, data + size);
+    }
+    putBigEndian(out, crc32(&out[start], size + 4));
+}
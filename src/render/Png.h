@@ -0,0 +1,24 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <vector>
+
+class Png {
+public:
+    ///@brief encodes 8-bit RGB pixels, rows top first, as a PNG file,
+    /// compressed with fixed-code deflate or stored if that is smaller
+    static void encode(const unsigned char *rgb, int width, int height, std::vector<unsigned char> &out);
+
+private:
+    static unsigned int crc32(const unsigned char *data, int size, unsigned int crc = 0);
+    static unsigned int adler32(const unsigned char *data, int size);
+    ///@brief picks the filter of every row by the smallest sum of
+    /// absolute differences, each row prefixed with its filter type
+    static void filterRows(const unsigned char *rgb, int width, int height, std::vector<unsigned char> &out);
+    ///@brief zlib stream of a single fixed Huffman block with greedy LZ77
+    static void deflate(const std::vector<unsigned char> &in, std::vector<unsigned char> &out);
+    static void store(const std::vector<unsigned char> &in, std::vector<unsigned char> &out);
+    static void writeChunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, int size);
+};
+
+#endif // PNG_H
@@ -1,53 +1,47 @@
 #include "RayCaster.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <memory>
+#include <mutex>
 
 Vector3f RayCaster::render(const Scene &scene, const Ray &ray) {
     Hit hit(true);
     if (scene.getGroup().intersect(ray, hit, scene.getCamera().getTMin())) {
-        auto color = scene.getAmbientLight() * hit.getMaterial()->getDiffuseColor();
-        for (int li = 0; li < scene.getNumLights(); ++li) {
-            Vector3f lightDirection, lightColor, shadingColor, envColor;
-            float dist;
-            scene.getLight(li).getIllumination(ray(hit.getT()), lightDirection, lightColor, dist);
-            if (hit.getMaterial()->hasCubeMap()) {
-                envColor = hit.getMaterial()->getEnvironmentColor(ray, hit);
-                color = color + envColor;
-            } else {
-                shadingColor = hit.getMaterial()->getShadingColor(ray, hit, lightDirection, lightColor, args.pixelated, true);
-                color = color + shadingColor;
-            }
+        if (aov != NULL) {
+            aov->set(scene, ray, hit);
         }
-        return color;
+        return shade(scene, ray, hit);
     } else {
         return scene.getBackgroundColor(ray.getDirection());
     }
 }
 
-Vector3f DepthRayCaster::render(const Scene &scene, const Ray &ray) {
-    Hit hit(true);
-    if (scene.getGroup().intersect(ray, hit, scene.getCamera().getTMin())) {
-        if (hit.getT() < args.depthMin) {
-            return Vector3f(1);
-        } else if (hit.getT() > args.depthMax) {
-            return Vector3f(0);
-        } else {
-            return Vector3f((args.depthMax - hit.getT()) / (args.depthMax - args.depthMin));
-        }
-    } else {
-        return Vector3f::ZERO;
+Vector3f RayCaster::shade(const Scene &scene, const Ray &ray, const Hit &hit) {
+    auto color = scene.getAmbientLight() * hit.getMaterial()->getDiffuseColor();
+    // a cube mapped material reflects its environment instead of being
+    // shaded by the lights, whatever lights are selected
+    if (hit.getMaterial()->hasCubeMap()) {
+        return color + hit.getMaterial()->getEnvironmentColor(ray, hit);
     }
+    auto p = ray(hit.getT());
+    scene.selectLights(p, args.lightCull, args.lightSamples, rng, selectedLights);
+    for (const auto &selection : selectedLights) {
+        Vector3f lightDirection, lightColor, shadingColor;
+        float dist;
+        scene.getLight(selection.light).getIllumination(p, lightDirection, lightColor, dist);
+        lightColor = selection.weight * lightColor;
+        shadingColor = hit.getMaterial()->getShadingColor(ray, hit, lightDirection, lightColor, args.pixelated, true);
+        color = color + shadingColor;
+    }
+    return color;
 }
 
-Vector3f NormalsRayCaster::render(const Scene &scene, const Ray &ray) {
+Vector3f AovRayCaster::render(const Scene &scene, const Ray &ray) {
     Hit hit(true);
-    if (scene.getGroup().intersect(ray, hit, scene.getCamera().getTMin())) {
-        auto n = hit.getNormal();
-        for (int i = 0; i < 3; ++i)
-            if (n[i] < 0)
-                n[i] = -n[i];
-        return n;
-    } else {
-        return Vector3f::ZERO;
+    if (aov != NULL && scene.getGroup().intersect(ray, hit, scene.getCamera().getTMin())) {
+        aov->set(scene, ray, hit);
     }
+    return Vector3f::ZERO;
 }
 
 Vector3f EnvironmentRayCaster::render(const Scene &scene, const Ray &ray) {
@@ -71,13 +65,142 @@ Vector3f EnvironmentRayCaster::render(const Scene &scene, const Ray &ray) {
     }
 }
 
-#define SAMPLE_SIZE 10.0f
+// lens samples per square pixel of circle of confusion
+#define LENS_SAMPLES_PER_AREA 1.2f
+// circles of confusion are spread to the pixels they reach up to this
+// radius in pixels, larger ones take the most samples anyway
+#define MAX_COC_RADIUS 16
+// color range under a pixel's circles that takes all of the samples
+#define FULL_CONTRAST 0.1f
+
+void BlurryRayCaster::beginImage(const Scene &scene, int w, int h, const CancellationToken *token) {
+    TRACE_SCOPE("lens prepass");
+    width = w;
+    // the clones of the pass are made without the samples of the last image
+    samples.clear();
+    auto thinLens = dynamic_cast<const ThinLensCamera *>(&scene.getCamera());
+    if (thinLens == NULL) {
+        samples.assign(w * h, args.lensSamplesMax);
+        return;
+    }
+    auto cancelled = [token]() {
+        return token != NULL && token->isCancelled();
+    };
+    // radius in pixels of the circle of confusion of every pixel's
+    // primary hit through the center of the lens, and its color; every
+    // chunk of rows shades with a clone, which has its own random numbers
+    // and selected lights
+    vector<float> coc(w * h);
+    vector<Vector3f> color(w * h);
+    unsigned seed = rng();
+    mutex counters;
+    parallelFor(0, h, [&](int j0, int j1) {
+        unique_ptr<BlurryRayCaster> f(static_cast<BlurryRayCaster *>(clone()));
+        f->resetCounters();
+        for (int j = j0; j < j1 && !cancelled(); ++j) {
+            // seeded by row, so that the chunks of rows of any number of
+            // threads draw the same numbers
+            f->rng.seed(seed ^ (j * 0x9e3779b9u));
+            for (int i = 0; i < w; ++i) {
+                Vector2f position(-1 + 2.0f * i / (w - 1), -1 + 2.0f * j / (h - 1));
+                Ray ray = thinLens->generateRay(position, Vector2f(0.5, 0.5));
+                ++f->rays.primary;
+                STAT_INC(STAT_PRIMARY_RAYS);
+                Hit hit(true);
+                float distance = INFINITY;
+                if (scene.getGroup().intersect(ray, hit, thinLens->getTMin())) {
+                    distance = hit.getT();
+                    color[j * w + i] = f->shade(scene, ray, hit);
+                } else {
+                    color[j * w + i] = scene.getBackgroundColor(ray.getDirection());
+                }
+                coc[j * w + i] = thinLens->circleOfConfusion(distance) * (w - 1) / 2;
+            }
+        }
+        lock_guard<mutex> lock(counters);
+        merge(*f);
+    }, threads);
+    samples.assign(w * h, args.lensSamplesMax);
+    if (cancelled()) {
+        return;
+    }
+    // a blurred surface spreads over its whole circle, so a pixel needs
+    // as many samples as the largest circle that covers it, scaled by how
+    // much the colors spread over it differ; circles are widened by a
+    // pixel so that edges within the pixel's own footprint count too
+    vector<float> reach(coc);
+    vector<Vector3f> lo(color), hi(color);
+    parallelFor(0, h, [&](int y0, int y1) {
+        // a chunk spreads the circles of all the rows that reach it, but
+        // only over its own rows
+        int spreadMax = MAX_COC_RADIUS + 1;
+        for (int j = max(0, y0 - spreadMax); j < min(h, y1 + spreadMax) && !cancelled(); ++j) {
+            for (int i = 0; i < w; ++i) {
+                float r = min(coc[j * w + i], (float)MAX_COC_RADIUS);
+                float spread = r + 1;
+                int ri = spread;
+                const Vector3f &c = color[j * w + i];
+                for (int y = max(y0, j - ri); y <= min(y1 - 1, j + ri); ++y) {
+                    for (int x = max(0, i - ri); x <= min(w - 1, i + ri); ++x) {
+                        if ((x - i) * (x - i) + (y - j) * (y - j) > spread * spread) {
+                            continue;
+                        }
+                        int k = y * w + x;
+                        reach[k] = max(reach[k], r);
+                        for (int ch = 0; ch < 3; ++ch) {
+                            lo[k][ch] = min(lo[k][ch], c[ch]);
+                            hi[k][ch] = max(hi[k][ch], c[ch]);
+                        }
+                    }
+                }
+            }
+        }
+        for (int k = y0 * w; k < y1 * w; ++k) {
+            Vector3f range = hi[k] - lo[k];
+            float contrast = min(1.0f, max(range[0], max(range[1], range[2])) / FULL_CONTRAST);
+            // at least the area of the pixel itself
+            float area = M_PI * max(reach[k] * reach[k], 1.0f);
+            int n = ceil(LENS_SAMPLES_PER_AREA * area * contrast);
+            samples[k] = max(args.lensSamplesMin, min(args.lensSamplesMax, n));
+        }
+    }, threads);
+}
+
+void BlurryRayCaster::beginPixel(int x, int y) {
+    pixel = y * width + x;
+}
+
 Vector3f BlurryRayCaster::renderPixel(const Scene &scene, const Camera &camera, Vector2f position) {
+    auto thinLens = dynamic_cast<const ThinLensCamera *>(&camera);
+    int n = samples.empty() ? args.lensSamplesMax : samples[pixel];
+    // Hammersley points, randomly shifted per pixel
+    uniform_real_distribution<float> unit(0, 1);
+    float shiftX = unit(rng), shiftY = unit(rng);
     Vector3f res;
-    for (int k = 0; k < SAMPLE_SIZE; ++k) {
-        auto ray = camera.generateRay(position);
-        res += render(scene, ray);
+    rays.primary += n;
+    STAT_ADD(STAT_PRIMARY_RAYS, n);
+    for (int k = 0; k < n; ++k) {
+        if (thinLens == NULL) {
+            res += render(scene, camera.generateRay(position));
+            continue;
+        }
+        Vector2f lens(fmod((k + shiftX) / n, 1.0f), fmod(radicalInverse(2, k) + shiftY, 1.0f));
+        res += render(scene, thinLens->generateRay(position, lens));
     }
-    res = res / SAMPLE_SIZE;
-    return res;
+    return res / n;
+}
+
+long BlurryRayCaster::getLensSamples() const {
+    long total = 0;
+    for (int n : samples) {
+        total += n;
+    }
+    return total;
+}
+
+std::string BlurryRayCaster::getLensStats() const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "Lens samples: %ld for %d pixels, %.2f per pixel",
+             getLensSamples(), (int)samples.size(), samples.empty() ? 0.0 : (double)getLensSamples() / samples.size());
+    return buf;
 }
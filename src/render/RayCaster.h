@@ -3,6 +3,8 @@
 
 #include "Arguments.h"
 #include "Renderer.h"
+#include <string>
+#include <vector>
 
 class RayCaster : public RenderFunction {
 public:
@@ -12,33 +14,61 @@ public:
     ~RayCaster() {}
 
     virtual Vector3f render(const Scene &scene, const Ray &ray);
+    virtual RenderFunction *clone() const {
+        return new RayCaster(*this);
+    }
 
 protected:
-    const Arguments &args;
-};
+    ///@brief direct lighting of the hit of ray
+    Vector3f shade(const Scene &scene, const Ray &ray, const Hit &hit);
 
-class DepthRayCaster : public RayCaster {
-public:
-    DepthRayCaster(const Arguments &args) : RayCaster(args) {}
-    virtual Vector3f render(const Scene &scene, const Ray &ray);
+    const Arguments &args;
+    std::vector<LightSelection> selectedLights;
 };
 
-class NormalsRayCaster : public RayCaster {
+///@brief only records the aovs, for renders without a color output
+class AovRayCaster : public RayCaster {
 public:
-    NormalsRayCaster(const Arguments &args) : RayCaster(args) {}
+    AovRayCaster(const Arguments &args) : RayCaster(args) {}
     virtual Vector3f render(const Scene &scene, const Ray &ray);
+    virtual RenderFunction *clone() const {
+        return new AovRayCaster(*this);
+    }
 };
 
+///@brief depth of field through the thin lens camera, with a number of
+/// stratified lens samples per pixel that follows the largest circle of
+/// confusion reaching the pixel and the colors it spreads there, from a
+/// pass through the lens center
 class BlurryRayCaster : public RayCaster {
 public:
     BlurryRayCaster(const Arguments &args) : RayCaster(args) {}
+    ///@brief the pre-pass that sets the lens samples of every pixel, on
+    /// threads threads; a cancelled token stops it
+    virtual void beginImage(const Scene &scene, int w, int h, const CancellationToken *token);
+    virtual void beginPixel(int x, int y);
     virtual Vector3f renderPixel(const Scene &scene, const Camera &camera, Vector2f position);
+    virtual RenderFunction *clone() const {
+        return new BlurryRayCaster(*this);
+    }
+
+    ///@brief the lens samples of every pixel of the last image, summed
+    long getLensSamples() const;
+    std::string getLensStats() const;
+
+private:
+    int width = 0;
+    int pixel = 0;
+    std::vector<int> samples;
 };
 
 class EnvironmentRayCaster : public RayCaster {
 public:
     EnvironmentRayCaster(const Arguments &args) : RayCaster(args) {}
     virtual Vector3f render(const Scene &scene, const Ray &ray);
+    virtual RenderFunction *clone() const {
+        return new EnvironmentRayCaster(*this);
+    }
 };
 
 #endif // RAYCASTER_H
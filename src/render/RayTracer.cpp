@@ -4,6 +4,8 @@
 #include "../data/Material.h"
 #include "../object3d/Group.h"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 
 #define VACCUM_REFRACTION_INDEX 1
@@ -17,7 +19,7 @@
  * @param d incoming ray direction
  * @return reflection direction
  */
-Vector3f mirrorDirection(const Vector3f &N, const Vector3f &d) {
+static Vector3f mirrorDirection(const Vector3f &N, const Vector3f &d) {
     // R = d - 2 (d . N) N
     return d - 2 * Vector3f::dot(d, N) * N;
 }
@@ -32,7 +34,7 @@ Vector3f mirrorDirection(const Vector3f &N, const Vector3f &d) {
  * @param r resulting reflection weight
  * @return refraction direction
  */
-Vector3f transmittedDirection(const Vector3f &N, const Vector3f &d,
+static Vector3f transmittedDirection(const Vector3f &N, const Vector3f &d,
                               float n, float nt, float &r) {
     // t = n (d - N (d . N)) / nt - N * sqrt(1 - (n^2 (1 - (d . N)^2)) / (nt^2))
     float ratio = n / nt;
@@ -55,15 +57,17 @@ Vector3f transmittedDirection(const Vector3f &N, const Vector3f &d,
 }
 
 Vector3f RayTracer::traceReflection(const Ray &ray, const Hit &hit,
-                                    int bounces, float refractionIndex) const {
+                                    int bounces, float refractionIndex) {
     auto reflectionDirection = mirrorDirection(hit.getNormal(), ray.getDirection());
     Ray reflectionRay(ray(hit.getT()), reflectionDirection);
+    ++rays.secondary;
+    STAT_INC(STAT_REFLECTION_RAYS);
     auto nextBounceColor = traceRay(reflectionRay, EPSILON, bounces + 1, refractionIndex);
     return hit.getMaterial()->getSpecularColor() * nextBounceColor;
 }
 
 Vector3f RayTracer::traceRefraction(const Ray &ray, const Hit &hit,
-                                    int bounces, float refractionIndex, float &r) const {
+                                    int bounces, float refractionIndex, float &r) {
     auto N = hit.getNormal();
     const auto &d = ray.getDirection();
     float n = refractionIndex, nt = hit.getMaterial()->getRefractionIndex();
@@ -74,30 +78,130 @@ Vector3f RayTracer::traceRefraction(const Ray &ray, const Hit &hit,
     Vector3f t = transmittedDirection(N, d, n, nt, r);
     if (r < 1) { // refraction occurs
         Ray refractionRay(ray(hit.getT()), t);
+        ++rays.secondary;
+        STAT_INC(STAT_REFRACTION_RAYS);
         auto nextBounceColor = traceRay(refractionRay, EPSILON, bounces + 1, nt);
         return hit.getMaterial()->getSpecularColor() * nextBounceColor;
     }
     return Vector3f::ZERO;
 }
 
-bool inShadow(Group &g, const Ray &ray, const Hit &hit,
-              const Vector3f &lightDirection, float lightDistance) {
+ostream &operator<<(ostream &os, const ShadowStats &s) {
+    os << "Shadow rays: " << s.queries << " queries, "
+       << s.traced << " traced, " << s.queries - s.traced << " saved ("
+       << s.cacheHits << " by the occluder cache, hit rate " << setprecision(1) << fixed
+       << (s.cacheTests ? 100.0 * s.cacheHits / s.cacheTests : 0.0) << "%, "
+       << s.reused << " reused from neighboring pixels)";
+    return os;
+}
+
+ShadowStats &operator+=(ShadowStats &s, const ShadowStats &other) {
+    s.queries += other.queries;
+    s.cacheTests += other.cacheTests;
+    s.cacheHits += other.cacheHits;
+    s.reused += other.reused;
+    s.traced += other.traced;
+    return s;
+}
+
+void RayTracer::merge(const RenderFunction &other) {
+    RenderFunction::merge(other);
+    shadowStats += static_cast<const RayTracer &>(other).shadowStats;
+}
+
+void RayTracer::resetCounters() {
+    RenderFunction::resetCounters();
+    shadowStats = ShadowStats();
+}
+
+/**
+ * @brief Visibility shared by the traced left and upper neighbors of
+ * the current pixel, when the three of them lie on the same flat surface
+ *
+ * @return 1 in shadow, 0 lit, -1 if it has to be traced
+ */
+int RayTracer::coherentVisibility(const Hit &hit, int light) const {
+    if (hit.objectIndex < 0 || pixelY < 1) {
+        return -1;
+    }
+    int n = scene->getNumLights();
+    const PixelShadow *neighbors[2] = {&pixels[0][pixelY], &pixels[1][pixelY - 1]};
+    int vis[2] = {visibility[0][pixelY * n + light], visibility[1][(pixelY - 1) * n + light]};
+    for (int k = 0; k < 2; ++k) {
+        if (vis[k] < 0 || neighbors[k]->x != pixelX - 1 + k || neighbors[k]->object != hit.objectIndex ||
+            Vector3f::dot(neighbors[k]->normal, hit.getNormal()) < 0.99f) {
+            return -1;
+        }
+    }
+    return vis[0] == vis[1] ? vis[0] : -1;
+}
+
+bool RayTracer::inShadow(const Ray &ray, const Hit &hit, int light,
+                         const Vector3f &lightDirection, float lightDistance, bool primary) {
+    ++shadowStats.queries;
+    // only the visibility of traced primary hits is recorded, so that a
+    // reused answer is never propagated further
+    signed char *record = NULL;
+    if (args.shadowCoherence && pixelY >= 0 && primary) {
+        int reused = coherentVisibility(hit, light);
+        if (reused >= 0) {
+            ++shadowStats.reused;
+            return reused;
+        }
+        record = &visibility[1][pixelY * scene->getNumLights() + light];
+    }
+
+    auto &g = scene->getGroup();
     Ray shadowRay(ray(hit.getT()), lightDirection);
-    Hit shadowHit(lightDistance);
-    return g.intersect(shadowRay, shadowHit, EPSILON);
+    ++rays.shadow;
+    STAT_INC(STAT_SHADOW_RAYS);
+    int &last = lastOccluder[light];
+    bool shadowed = false;
+    if (last >= 0) {
+        // adjacent pixels are usually blocked by the same object
+        ++shadowStats.cacheTests;
+        Hit shadowHit(lightDistance);
+        if (g.getObject(last)->intersect(shadowRay, shadowHit, EPSILON)) {
+            ++shadowStats.cacheHits;
+            shadowed = true;
+        }
+    }
+    if (!shadowed) {
+        ++shadowStats.traced;
+        int occluder = g.occluder(shadowRay, EPSILON, lightDistance, last);
+        if (occluder >= 0) {
+            last = occluder;
+            shadowed = true;
+        }
+    }
+    if (record != NULL) {
+        *record = shadowed;
+    }
+    return shadowed;
 }
 
 Vector3f RayTracer::traceRay(const Ray &ray, float tmin, int bounces,
-                             float refractionIndex) const {
+                             float refractionIndex) {
     Hit hit;
     auto &g = scene->getGroup();
     if (g.intersect(ray, hit, tmin)) {
+        if (bounces == 0 && args.shadowCoherence && pixelY >= 0) {
+            pixels[1][pixelY].x = pixelX;
+            pixels[1][pixelY].object = hit.objectIndex;
+            pixels[1][pixelY].normal = hit.getNormal();
+        }
+        if (bounces == 0 && aov != NULL) {
+            aov->set(*scene, ray, hit);
+        }
         auto color = scene->getAmbientLight() * hit.getMaterial()->getDiffuseColor();
-        for (int li = 0; li < scene->getNumLights(); ++li) {
+        auto p = ray(hit.getT());
+        scene->selectLights(p, args.lightCull, args.lightSamples, rng, selectedLights);
+        for (const auto &selection : selectedLights) {
             Vector3f lightDirection, lightColor;
             float lightDistance;
-            scene->getLight(li).getIllumination(ray(hit.getT()), lightDirection, lightColor, lightDistance);
-            if (args.shadows && inShadow(g, ray, hit, lightDirection, lightDistance))
+            scene->getLight(selection.light).getIllumination(p, lightDirection, lightColor, lightDistance);
+            lightColor = selection.weight * lightColor;
+            if (args.shadows && inShadow(ray, hit, selection.light, lightDirection, lightDistance, bounces == 0))
                 continue;
             auto shadingColor = hit.getMaterial()->getShadingColor(ray, hit, lightDirection, lightColor, args.pixelated);
             color = color + shadingColor;
@@ -114,7 +218,30 @@ Vector3f RayTracer::traceRay(const Ray &ray, float tmin, int bounces,
     }
 }
 
+void RayTracer::beginPixel(int x, int y) {
+    if (x != pixelX) {
+        // the current column becomes the previous one
+        swap(pixels[0], pixels[1]);
+        swap(visibility[0], visibility[1]);
+        pixelX = x;
+    }
+    pixelY = y;
+}
+
 Vector3f RayTracer::render(const Scene &scene, const Ray &ray) {
     this->scene = &scene;
+    int n = scene.getNumLights();
+    lastOccluder.resize(n, -1);
+    if (args.shadowCoherence && pixelY >= 0) {
+        size_t size = pixelY + 1;
+        for (int c = 0; c < 2; ++c) {
+            if (pixels[c].size() < size) {
+                pixels[c].resize(size);
+                visibility[c].resize(size * n, -1);
+            }
+        }
+        pixels[1][pixelY] = PixelShadow();
+        fill_n(visibility[1].begin() + pixelY * n, n, -1);
+    }
     return traceRay(ray, scene.getCamera().getTMin(), 0, VACCUM_REFRACTION_INDEX);
 }
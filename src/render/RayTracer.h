@@ -6,8 +6,24 @@
 #include "Arguments.h"
 #include "Renderer.h"
 #include <cassert>
+#include <iostream>
 #include <vector>
 
+struct ShadowStats {
+    // visibility queries made while shading
+    long long queries = 0;
+    // queries tested against the cached occluder first, and how many it blocked
+    long long cacheTests = 0;
+    long long cacheHits = 0;
+    // queries answered from the neighboring pixels
+    long long reused = 0;
+    // queries that went through the whole scene
+    long long traced = 0;
+};
+
+ostream &operator<<(ostream &os, const ShadowStats &s);
+ShadowStats &operator+=(ShadowStats &s, const ShadowStats &other);
+
 class RayTracer : public RenderFunction {
 public:
     RayTracer() = delete;
@@ -15,18 +31,50 @@ public:
         : args(args) {}
     ~RayTracer() {}
 
+    virtual void beginPixel(int x, int y);
     virtual Vector3f render(const Scene &scene, const Ray &ray);
+    virtual RenderFunction *clone() const {
+        return new RayTracer(*this);
+    }
+    virtual void merge(const RenderFunction &other);
+    virtual void resetCounters();
+
+    const ShadowStats &getShadowStats() const {
+        return shadowStats;
+    }
 
 protected:
     const Arguments &args;
     Scene const *scene = NULL;
+    // reused between hits, the light loop finishes before the next bounce
+    std::vector<LightSelection> selectedLights;
+
+    // shadow cache, the last object that blocked each light
+    std::vector<int> lastOccluder;
+    ShadowStats shadowStats;
+
+    // screen-space coherence, visibility of the primary hits of the
+    // previous and the current column (-1 when unknown or reused)
+    struct PixelShadow {
+        // column the record was written in, pixels are not always
+        // visited column by column
+        int x = -1;
+        int object = -1;
+        Vector3f normal;
+    };
+    int pixelX = -1, pixelY = -1;
+    std::vector<PixelShadow> pixels[2];
+    std::vector<signed char> visibility[2];
 
     Vector3f traceRay(const Ray &ray,
-                      float tmin, int bounces, float refr_index) const;
+                      float tmin, int bounces, float refr_index);
     Vector3f traceReflection(const Ray &ray, const Hit &hit,
-                             int bounces, float refractionIndex) const;
+                             int bounces, float refractionIndex);
     Vector3f traceRefraction(const Ray &ray, const Hit &hit,
-                             int bounces, float refractionIndex, float &r) const;
+                             int bounces, float refractionIndex, float &r);
+    bool inShadow(const Ray &ray, const Hit &hit, int light,
+                  const Vector3f &lightDirection, float lightDistance, bool primary);
+    int coherentVisibility(const Hit &hit, int light) const;
 };
 
 #endif // RAYTRACER_H
@@ -1,40 +1,373 @@
 #include "Renderer.h"
+#include "Trace.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
 Vector3f RenderFunction::renderPixel(const Scene &scene, const Camera &camera, Vector2f position) {
-    auto ray = camera.generateRay(position);
+    auto ray = camera.generateRay(position, rng);
+    ++rays.primary;
+    STAT_INC(STAT_PRIMARY_RAYS);
     return render(scene, ray);
 }
 
-void Renderer::renderScene(
+///@brief renders a sample of func, with the cycles and the traversal
+/// steps it took recorded in func.aov if the sample has one
+static Vector3f renderSample(RenderFunction &func, const Scene &scene, const Camera &camera, Vector2f position) {
+    if (func.aov == NULL) {
+        return func.renderPixel(scene, camera, position);
+    }
+    long long steps = RenderStats::local().steps();
+    unsigned long long t0 = cycleCount();
+    auto color = func.renderPixel(scene, camera, position);
+    func.aov->cycles = cycleCount() - t0;
+    func.aov->steps = RenderStats::local().steps() - steps;
+    return color;
+}
+
+///@brief the aov sample to record pixel (x, y) of an image scale times
+/// the size of aovs into, cleared, or NULL if the pixel is not recorded
+static AovSample *aovSample(AovBuffers *aovs, int x, int y, int scale = 1) {
+    if (aovs == NULL || x % scale != scale / 2 || y % scale != scale / 2) {
+        return NULL;
+    }
+    AovSample *sample = &aovs->at(x / scale, y / scale);
+    *sample = AovSample();
+    return sample;
+}
+
+bool Renderer::forEachTile(
+    Framebuffer &fb,
+    RenderFunction &func,
+    bool replace,
+    function<void(RenderFunction &, int, int, int, int, TileSamples &)> renderTile,
+    function<void(double)> onProgress,
+    const CancellationToken *token) {
+    int w = fb.getWidth(), h = fb.getHeight();
+    int tilesX = (w + TILE_SIZE - 1) / TILE_SIZE, tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+    int count = tilesX * tilesY;
+    // every tile draws its own random numbers, whichever thread renders
+    // it, so that the image does not depend on the number of threads
+    unsigned seed = func.rng();
+    // tile k, column by column
+    auto renderTileAt = [&](RenderFunction &f, TileSamples &tile, int k) {
+        int x0 = k / tilesY * TILE_SIZE, y0 = k % tilesY * TILE_SIZE;
+        TRACE_SCOPE("tile", NULL, x0, y0);
+        f.rng.seed(seed ^ (k * 0x9e3779b9u));
+        tile.clear();
+        renderTile(f, x0, y0, min(x0 + TILE_SIZE, w), min(y0 + TILE_SIZE, h), tile);
+        fb.merge(x0, y0, tile, replace);
+    };
+    int threads = max(1, min(func.threads, count));
+    if (threads == 1) {
+        auto tile = make_unique<TileSamples>();
+        for (int k = 0; k < count; ++k) {
+            if (token != NULL && token->isCancelled()) {
+                func.rng.seed(seed);
+                return false;
+            }
+            renderTileAt(func, *tile, k);
+            onProgress((double)(k + 1) / count);
+        }
+        func.rng.seed(seed);
+        return true;
+    }
+
+    // every thread takes the next tile left until there are none or the
+    // token is cancelled, the calling thread reports the progress
+    vector<unique_ptr<RenderFunction>> clones;
+    for (int t = 1; t < threads; ++t) {
+        clones.emplace_back(func.clone());
+        clones.back()->resetCounters();
+    }
+    atomic<int> next{0};
+    mutex progressMutex;
+    condition_variable progressed;
+    int done = 0, idle = 0;
+    auto work = [&](RenderFunction &f) {
+        auto tile = make_unique<TileSamples>();
+        for (int k; !(token != NULL && token->isCancelled()) && (k = next++) < count;) {
+            renderTileAt(f, *tile, k);
+            lock_guard<mutex> lock(progressMutex);
+            ++done;
+            progressed.notify_one();
+        }
+        lock_guard<mutex> lock(progressMutex);
+        ++idle;
+        progressed.notify_one();
+    };
+    vector<thread> workers;
+    workers.emplace_back(work, ref(func));
+    for (auto &clone : clones) {
+        workers.emplace_back(work, ref(*clone));
+    }
+    {
+        unique_lock<mutex> lock(progressMutex);
+        for (int reported = 0; idle < threads;) {
+            progressed.wait(lock, [&] { return done > reported || idle == threads; });
+            if (done > reported) {
+                reported = done;
+                lock.unlock();
+                onProgress((double)reported / count);
+                lock.lock();
+            }
+        }
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (auto &clone : clones) {
+        func.merge(*clone);
+    }
+    // the next call draws its seed from where this one started, not from
+    // the last tile of func
+    func.rng.seed(seed);
+    return done == count;
+}
+
+bool Renderer::renderScene(
     const Scene &scene,
     Image &img,
     RenderFunction &func,
     bool jittered,
-    function<void(double)> onProgress) {
+    function<void(double)> onProgress,
+    const CancellationToken *token,
+    AovBuffers *aovs) {
+    TRACE_SCOPE("render");
     int w = img.getWidth(), h = img.getHeight();
     if (jittered) {
         w *= 3;
         h *= 3;
-        img.reset(w, h);
     }
     auto &camera = scene.getCamera();
-    for (int i = 0; i < w; ++i) {
-        for (int j = 0; j < h; ++j) {
-            float x = i, y = j;
-            if (jittered) {
-                x += (float)rand() / RAND_MAX - 0.5;
-                y += (float)rand() / RAND_MAX - 0.5;
+    func.beginImage(scene, w, h, token);
+    uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+    // one sample per pixel, written straight into img; black where a
+    // cancelled render did not get to
+    img.reset(w, h);
+    img.setAllPixels(Vector3f::ZERO);
+    Framebuffer fb(img);
+    bool done = forEachTile(
+        fb, func, false,
+        [&](RenderFunction &f, int x0, int y0, int x1, int y1, TileSamples &tile) {
+            for (int i = x0; i < x1; ++i) {
+                for (int j = y0; j < y1; ++j) {
+                    float x = i, y = j;
+                    if (jittered) {
+                        x += jitter(f.rng);
+                        y += jitter(f.rng);
+                    }
+                    x = -1 + 2 * x / (w - 1), y = -1 + 2 * y / (h - 1);
+                    f.beginPixel(i, j);
+                    // the aovs keep the pixel size, with the middle sample
+                    // of the 3x3 jittered ones
+                    f.aov = aovSample(aovs, i, j, jittered ? 3 : 1);
+                    auto pixel = renderSample(f, scene, camera, Vector2f(x, y));
+                    tile.addSample((j - y0) * TILE_SIZE + i - x0, pixel);
+                }
+            }
+        },
+        onProgress, token);
+    func.aov = NULL;
+    cout << endl;
+    return done;
+}
+
+bool Renderer::renderAdaptive(
+    const Scene &scene,
+    Image &img,
+    RenderFunction &func,
+    float threshold,
+    int maxSamples,
+    function<void(double)> onProgress,
+    const CancellationToken *token,
+    AovBuffers *aovs) {
+    TRACE_SCOPE("render");
+    int w = img.getWidth(), h = img.getHeight();
+    auto &camera = scene.getCamera();
+    func.beginImage(scene, w, h, token);
+    Framebuffer samples(w, h, true);
+    uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+    auto sample = [&](RenderFunction &f, TileSamples &tile, int x0, int y0, int i, int j, bool jittered) {
+        float x = i, y = j;
+        if (jittered) {
+            x += jitter(f.rng);
+            y += jitter(f.rng);
+        }
+        x = -1 + 2 * x / (w - 1), y = -1 + 2 * y / (h - 1);
+        f.beginPixel(i, j);
+        tile.addSample((j - y0) * TILE_SIZE + i - x0, renderSample(f, scene, camera, Vector2f(x, y)));
+    };
+
+    bool done = forEachTile(
+        samples, func, false,
+        [&](RenderFunction &f, int x0, int y0, int x1, int y1, TileSamples &tile) {
+            for (int i = x0; i < x1; ++i) {
+                for (int j = y0; j < y1; ++j) {
+                    f.aov = aovSample(aovs, i, j);
+                    sample(f, tile, x0, y0, i, j, false);
+                }
             }
-            x = -1 + 2 * x / (w - 1), y = -1 + 2 * y / (h - 1);
-            auto pixel = func.renderPixel(scene, camera, Vector2f(x, y));
-            img.setPixel(i, j, pixel);
+        },
+        onProgress, token);
+    func.aov = NULL;
+
+    // refine until every pixel is either flat or at maxSamples, a
+    // refined pixel doubles its sample count each round
+    vector<int> refine(w * h);
+    for (int round = 1; done; ++round) {
+        int flagged = 0;
+        for (int i = 0; i < w; ++i) {
+            for (int j = 0; j < h; ++j) {
+                int n = samples.getCount(i, j);
+                bool over = samples.getContrast(i, j) > threshold || samples.getError(i, j) > threshold;
+                refine[j * w + i] = over ? min(n, maxSamples - n) : 0;
+                flagged += refine[j * w + i] > 0;
+            }
+        }
+        if (flagged == 0) {
+            break;
         }
-        onProgress((float)(i + 1) / w);
+        cout << endl
+             << "Adaptive sampling round " << round << ": " << flagged << " pixels" << endl;
+        done = forEachTile(
+            samples, func, false,
+            [&](RenderFunction &f, int x0, int y0, int x1, int y1, TileSamples &tile) {
+                for (int i = x0; i < x1; ++i) {
+                    for (int j = y0; j < y1; ++j) {
+                        for (int k = 0; k < refine[j * w + i]; ++k) {
+                            sample(f, tile, x0, y0, i, j, true);
+                        }
+                    }
+                }
+            },
+            onProgress, token);
     }
     cout << endl;
+    samples.resolve(img);
+    return done;
+}
+
+bool Renderer::renderPixels(
+    const Scene &scene,
+    Image &img,
+    RenderFunction &func,
+    const vector<bool> &trace,
+    function<void(double)> onProgress,
+    const CancellationToken *token,
+    AovBuffers *aovs) {
+    TRACE_SCOPE("render");
+    int w = img.getWidth(), h = img.getHeight();
+    auto &camera = scene.getCamera();
+    func.beginImage(scene, w, h, token);
+    // the pixels not traced keep what img has
+    Framebuffer fb(img);
+    bool done = forEachTile(
+        fb, func, true,
+        [&](RenderFunction &f, int x0, int y0, int x1, int y1, TileSamples &tile) {
+            for (int i = x0; i < x1; ++i) {
+                for (int j = y0; j < y1; ++j) {
+                    if (!trace[j * w + i]) {
+                        continue;
+                    }
+                    float x = -1 + 2.0f * i / (w - 1), y = -1 + 2.0f * j / (h - 1);
+                    f.beginPixel(i, j);
+                    f.aov = aovSample(aovs, i, j);
+                    tile.addSample((j - y0) * TILE_SIZE + i - x0, renderSample(f, scene, camera, Vector2f(x, y)));
+                }
+            }
+        },
+        onProgress, token);
+    func.aov = NULL;
+    cout << endl;
+    return done;
+}
+
+float radicalInverse(int base, int i) {
+    float inv = 1.0f / base, f = inv, r = 0;
+    for (; i > 0; i /= base, f *= inv) {
+        r += f * (i % base);
+    }
+    return r;
+}
+
+bool Renderer::renderProgressive(
+    const Scene &scene,
+    Image &img,
+    RenderFunction &func,
+    int maxSpp,
+    int timeBudgetMs,
+    function<void(double)> onProgress,
+    function<void(const Image &, int)> onPass,
+    const CancellationToken *token,
+    AovBuffers *aovs) {
+    TRACE_SCOPE("render");
+    using namespace std::chrono;
+    auto t0 = steady_clock::now();
+    auto elapsedMs = [&t0]() {
+        return duration_cast<milliseconds>(steady_clock::now() - t0).count();
+    };
+    int w = img.getWidth(), h = img.getHeight();
+    auto &camera = scene.getCamera();
+    func.beginImage(scene, w, h, token);
+    Framebuffer samples(w, h);
+    // the time budget cancels the pass in progress the same way as token,
+    // but not the first one, so that every pixel gets a sample
+    CancellationToken budget;
+    bool done = true;
+    int spp = 0;
+    while ((maxSpp <= 0 || spp < maxSpp) && done && !budget.isCancelled() &&
+           (token == NULL || !token->isCancelled())) {
+        // halton (2, 3) offsets shifted so that the first pass samples
+        // pixel centers, every prefix of the passes stays stratified
+        float dx = fmod(radicalInverse(2, spp) + 0.5f, 1.0f) - 0.5f;
+        float dy = fmod(radicalInverse(3, spp) + 0.5f, 1.0f) - 0.5f;
+        done = forEachTile(
+            samples, func, false,
+            [&](RenderFunction &f, int x0, int y0, int x1, int y1, TileSamples &tile) {
+                for (int i = x0; i < x1; ++i) {
+                    for (int j = y0; j < y1; ++j) {
+                        float x = -1 + 2 * (i + dx) / (w - 1), y = -1 + 2 * (j + dy) / (h - 1);
+                        f.beginPixel(i, j);
+                        f.aov = spp == 0 ? aovSample(aovs, i, j) : NULL;
+                        tile.addSample((j - y0) * TILE_SIZE + i - x0, renderSample(f, scene, camera, Vector2f(x, y)));
+                    }
+                }
+                if ((timeBudgetMs > 0 && elapsedMs() >= timeBudgetMs) ||
+                    (token != NULL && token->isCancelled())) {
+                    budget.cancel();
+                }
+            },
+            [&](double tiles) {
+                double progress = maxSpp > 0 ? (spp + tiles) / maxSpp : 0;
+                if (timeBudgetMs > 0) {
+                    progress = max(progress, min(1.0, (double)elapsedMs() / timeBudgetMs));
+                }
+                onProgress(progress);
+            },
+            spp == 0 ? token : &budget);
+        // a later pass cut short leaves some pixels with one sample less,
+        // which only makes them noisier; a cancelled first pass leaves the
+        // pixels it did not reach black, as a cancelled render does
+        ++spp;
+        samples.resolve(img);
+        if (onPass) {
+            onPass(img, spp);
+        }
+    }
+    func.aov = NULL;
+    cout << endl
+         << "Progressive rendering: " << spp << " passes in " << elapsedMs() << " ms" << endl;
+    // running out of time is the expected way for a budgeted render to end
+    return token == NULL || !token->isCancelled();
 }
@@ -3,24 +3,142 @@
 
 #include "../data/Camera.h"
 #include "../data/Scene.h"
+#include "Aov.h"
 #include "Arguments.h"
+#include "Cancellation.h"
+#include "Framebuffer.h"
 #include "Image.h"
+#include "Stats.h"
 #include <functional>
+#include <random>
+#include <vector>
+
+///@brief rays cast by a render function, by kind
+struct RayCounts {
+    // from the camera, one per lens sample for depth of field
+    long long primary = 0;
+    // reflected and refracted
+    long long secondary = 0;
+    // toward the lights, the ones answered without a ray are not counted
+    long long shadow = 0;
+    long long total() const {
+        return primary + secondary + shadow;
+    }
+    RayCounts &operator+=(const RayCounts &other) {
+        primary += other.primary;
+        secondary += other.secondary;
+        shadow += other.shadow;
+        return *this;
+    }
+};
 
 class RenderFunction {
 public:
+    ///@brief called with the size of the image before its pixels are
+    /// rendered, with the token of the render for a pass of its own
+    virtual void beginImage(__attribute__((unused)) const Scene &scene,
+                            __attribute__((unused)) int w, __attribute__((unused)) int h,
+                            __attribute__((unused)) const CancellationToken *token) {}
+    ///@brief called with the image coordinates of the pixel rendered next
+    virtual void beginPixel(__attribute__((unused)) int x, __attribute__((unused)) int y) {}
     virtual Vector3f renderPixel(const Scene &scene, const Camera &camera, Vector2f position);
     virtual Vector3f render(const Scene &scene, const Ray &ray) = 0;
+    ///@brief a copy, after beginImage, for another thread to render
+    /// tiles with
+    virtual RenderFunction *clone() const = 0;
+    ///@brief adds the counters of a clone that rendered tiles
+    virtual void merge(const RenderFunction &other) {
+        rays += other.rays;
+    }
+    virtual void resetCounters() {
+        rays = RayCounts();
+    }
+    virtual ~RenderFunction() {}
+
+    ///@brief when set, render() records what the primary ray hit in it
+    AovSample *aov = NULL;
+    RayCounts rays;
+    ///@brief threads rendering the tiles, each with a clone of this
+    /// function but the first
+    int threads = 1;
+    ///@brief random numbers of this function, reseeded for every tile so
+    /// that a tile draws the same ones on any thread
+    std::minstd_rand rng;
 };
 
+///@brief i-th element of the van der Corput sequence in base
+float radicalInverse(int base, int i);
+
+///@brief all render functions return false if they were cancelled, and
+/// leave what was rendered so far in img; aovs, of the size of img, get
+/// the primary hit of the first sample of every pixel. Tiles are rendered
+/// into tile-local samples merged into a Framebuffer once per tile, by
+/// renderFunc.threads threads
 class Renderer {
 public:
-    static void renderScene(
+    static bool renderScene(
         const Scene &scene,
         Image &img,
         RenderFunction &renderFunc,
         bool jittered,
-        function<void(double)> onProgress);
+        function<void(double)> onProgress,
+        const CancellationToken *token = NULL,
+        AovBuffers *aovs = NULL);
+
+    ///@brief renders one sample per pixel, then keeps adding jittered
+    /// samples to the pixels whose contrast with their neighbors or
+    /// whose standard error is over threshold, up to maxSamples
+    static bool renderAdaptive(
+        const Scene &scene,
+        Image &img,
+        RenderFunction &renderFunc,
+        float threshold,
+        int maxSamples,
+        function<void(double)> onProgress,
+        const CancellationToken *token = NULL,
+        AovBuffers *aovs = NULL);
+
+    ///@brief renders one sample per pixel per pass, at stratified
+    /// subpixel offsets, until maxSpp passes or timeBudgetMs have been
+    /// spent (0 for no limit); img is updated after every pass and
+    /// handed to onPass with the current samples per pixel
+    static bool renderProgressive(
+        const Scene &scene,
+        Image &img,
+        RenderFunction &renderFunc,
+        int maxSpp,
+        int timeBudgetMs,
+        function<void(double)> onProgress,
+        function<void(const Image &, int)> onPass,
+        const CancellationToken *token = NULL,
+        AovBuffers *aovs = NULL);
+
+    ///@brief renders only the pixels set in trace (indexed y * width + x),
+    /// the others keep their color and aovs
+    static bool renderPixels(
+        const Scene &scene,
+        Image &img,
+        RenderFunction &renderFunc,
+        const std::vector<bool> &trace,
+        function<void(double)> onProgress,
+        const CancellationToken *token = NULL,
+        AovBuffers *aovs = NULL);
+
+private:
+    ///@brief calls renderTile(f, x0, y0, x1, y1, tile) on every tile of
+    /// fb with cleared samples, merges them into fb, with replace for the
+    /// pixels that got samples, and calls onProgress with the fraction of
+    /// tiles done; with func.threads above 1, the tiles are shared out to
+    /// threads that each render with a clone f of func, while onProgress
+    /// and token are only used from the calling thread
+    ///@return false if token was cancelled before all tiles were done
+    static bool forEachTile(
+        Framebuffer &fb,
+        RenderFunction &func,
+        bool replace,
+        function<void(RenderFunction &, int, int, int, int, TileSamples &)> renderTile,
+        function<void(double)> onProgress,
+        const CancellationToken *token);
 };
 
 #endif // RENDERER_H
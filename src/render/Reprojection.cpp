@@ -0,0 +1,98 @@
+#include "Reprojection.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+// a pixel whose reprojected hit is this much farther than one of its
+// neighbors' may show a surface through a hole of a closer one
+#define DEPTH_TOLERANCE 1.1f
+
+///@brief the fraction of the pixels refreshed in every frame, spread
+/// over the image and moving from frame to frame
+static bool refreshed(int pixel, int frame, float refresh) {
+    unsigned int hash = (unsigned int)pixel * 2654435761u ^ (unsigned int)frame * 40503u;
+    hash ^= hash >> 15;
+    return (hash & 0xffff) < refresh * 0x10000;
+}
+
+int ReprojectionCache::reproject(const Camera &camera, Image &img, AovBuffers &aovs,
+                                 vector<bool> &trace, float refresh) {
+    int w = img.getWidth(), h = img.getHeight();
+    trace.assign(w * h, true);
+    if (color.getWidth() != w || color.getHeight() != h ||
+        dynamic_cast<const PerspectiveCamera *>(&camera) == NULL) {
+        return w * h;
+    }
+    Vector2f point;
+    Vector3f origin = camera.generateRay(Vector2f(0, 0)).getOrigin();
+
+    // forward splat of the previous hits, the closest one wins
+    vector<float> depth(w * h, FLT_MAX);
+    for (int i = 0; i < w; ++i) {
+        for (int j = 0; j < h; ++j) {
+            const AovSample &s = hits.at(i, j);
+            if (!s.hit || invalidObjects.count(s.object) || !camera.project(s.position, point)) {
+                continue;
+            }
+            int x = lround((point[0] + 1) * (w - 1) / 2), y = lround((point[1] + 1) * (h - 1) / 2);
+            if (x < 0 || x >= w || y < 0 || y >= h) {
+                continue;
+            }
+            float d = (s.position - origin).abs();
+            if (d < depth[y * w + x]) {
+                depth[y * w + x] = d;
+                img.setPixel(x, y, color.getPixel(i, j));
+                aovs.at(x, y) = s;
+                aovs.at(x, y).depth = d;
+            }
+        }
+    }
+
+    // what moved objects may now hide, screen rectangles of their bounds
+    for (const Box &b : movedBounds) {
+        int x0 = w, y0 = h, x1 = -1, y1 = -1;
+        for (int k = 0; k < 8; ++k) {
+            Vector3f corner(k & 1 ? b.mx[0] : b.mn[0], k & 2 ? b.mx[1] : b.mn[1], k & 4 ? b.mx[2] : b.mn[2]);
+            if (!camera.project(corner, point)) {
+                // partly behind the camera, may cover anything
+                return w * h;
+            }
+            int x = lround((point[0] + 1) * (w - 1) / 2), y = lround((point[1] + 1) * (h - 1) / 2);
+            x0 = min(x0, x), y0 = min(y0, y), x1 = max(x1, x), y1 = max(y1, y);
+        }
+        for (int x = max(x0, 0); x <= min(x1, w - 1); ++x) {
+            for (int y = max(y0, 0); y <= min(y1, h - 1); ++y) {
+                depth[y * w + x] = -1;
+            }
+        }
+    }
+
+    int count = 0;
+    for (int x = 0; x < w; ++x) {
+        for (int y = 0; y < h; ++y) {
+            float d = depth[y * w + x];
+            bool covered = d >= 0 && d < FLT_MAX && !refreshed(y * w + x, frame, refresh);
+            for (int dx = -1; dx <= 1 && covered; ++dx) {
+                for (int dy = -1; dy <= 1 && covered; ++dy) {
+                    int nx = x + dx, ny = y + dy;
+                    if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
+                        covered = d <= depth[ny * w + nx] * DEPTH_TOLERANCE;
+                    }
+                }
+            }
+            trace[y * w + x] = !covered;
+            count += !covered;
+        }
+    }
+    return count;
+}
+
+void ReprojectionCache::store(const Image &img, const AovBuffers &aovs) {
+    color.setImage(img);
+    hits = aovs;
+    invalidObjects.clear();
+    movedBounds.clear();
+    ++frame;
+}
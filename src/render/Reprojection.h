@@ -0,0 +1,48 @@
+#ifndef REPROJECTION_H
+#define REPROJECTION_H
+
+#include "../data/Camera.h"
+#include "../data/Octree.h"
+#include "Aov.h"
+#include "Image.h"
+#include <set>
+#include <vector>
+
+///@brief the shaded color and primary hit of every pixel of the previous
+/// frame, reprojected through the camera of the next frame so that only
+/// the pixels it does not cover have to be traced again
+class ReprojectionCache {
+public:
+    ReprojectionCache()
+        : color(0, 0), hits(0, 0) {}
+
+    ///@brief fills img and aovs with the previous frame as seen by camera
+    ///@param trace set for the pixels to trace: those no previous hit
+    /// lands on, those a previous hit may have been seen through, and a
+    /// refresh fraction of the others, so that no pixel gets too stale
+    ///@return the number of pixels to trace
+    int reproject(const Camera &camera, Image &img, AovBuffers &aovs,
+                  std::vector<bool> &trace, float refresh);
+    ///@brief keeps the frame just rendered for the next one
+    void store(const Image &img, const AovBuffers &aovs);
+
+    ///@brief drops the whole frame, e.g. when the lighting changed
+    void invalidate() {
+        color.reset(0, 0);
+    }
+    ///@brief drops the pixels of a top-level object that moved, and
+    /// traces again the pixels its new bounds may cover
+    void invalidateObject(int object, const Box &bounds) {
+        invalidObjects.insert(object);
+        movedBounds.push_back(bounds);
+    }
+
+private:
+    Image color;
+    AovBuffers hits;
+    std::set<int> invalidObjects;
+    std::vector<Box> movedBounds;
+    int frame = 0;
+};
+
+#endif // REPROJECTION_H
@@ -0,0 +1,153 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///@brief out[i] = in[i] * 255 clamped to [0, 255] and truncated, the
+/// same as ClampColorComponent; NaN becomes 0
+inline void clampToBytes(const float *in, unsigned char *out, int n) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 zero = _mm_setzero_ps(), max = _mm_set1_ps(255), scale = _mm_set1_ps(255);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128 c = _mm_mul_ps(_mm_loadu_ps(in + i + 4 * k), scale);
+            // max first, it returns zero for NaN
+            c = _mm_min_ps(_mm_max_ps(c, zero), max);
+            v[k] = _mm_cvttps_epi32(c);
+        }
+        __m128i lo = _mm_packs_epi32(v[0], v[1]), hi = _mm_packs_epi32(v[2], v[3]);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        float c = in[i] * 255;
+        out[i] = c > 0 ? (c < 255 ? (unsigned char)c : 255) : 0;
+    }
+}
+
+///@brief four floats, in one SSE register when available
+struct Float4 {
+#ifdef __SSE2__
+    __m128 v;
+    static Float4 load(const float *p) {
+        return {_mm_loadu_ps(p)};
+    }
+    static Float4 broadcast(float f) {
+        return {_mm_set1_ps(f)};
+    }
+    void store(float *p) const {
+        _mm_storeu_ps(p, v);
+    }
+    Float4 operator+(Float4 o) const {
+        return {_mm_add_ps(v, o.v)};
+    }
+    Float4 operator-(Float4 o) const {
+        return {_mm_sub_ps(v, o.v)};
+    }
+    Float4 operator*(Float4 o) const {
+        return {_mm_mul_ps(v, o.v)};
+    }
+    Float4 operator/(Float4 o) const {
+        return {_mm_div_ps(v, o.v)};
+    }
+    static Float4 min(Float4 a, Float4 b) {
+        return {_mm_min_ps(a.v, b.v)};
+    }
+    static Float4 max(Float4 a, Float4 b) {
+        return {_mm_max_ps(a.v, b.v)};
+    }
+    static Float4 abs(Float4 a) {
+        return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)};
+    }
+    static Float4 sqrt(Float4 a) {
+        return {_mm_sqrt_ps(a.v)};
+    }
+    ///@brief e^x, relative error under 1e-5 for x in [-87, 88], clamped
+    /// to that range
+    static Float4 exp(Float4 x) {
+        x = min(max(x, broadcast(-87)), broadcast(88));
+        // e^x = 2^n * 2^f with n the nearest integer of x / ln 2
+        Float4 t = x * broadcast(1.44269504f);
+        __m128i n = _mm_cvtps_epi32(t.v);
+        Float4 f = (t - Float4{_mm_cvtepi32_ps(n)}) * broadcast(0.69314718f);
+        // Taylor series of e^f, |f| <= ln 2 / 2
+        Float4 p = broadcast(1.0f / 720);
+        p = p * f + broadcast(1.0f / 120);
+        p = p * f + broadcast(1.0f / 24);
+        p = p * f + broadcast(1.0f / 6);
+        p = p * f + broadcast(0.5f);
+        p = p * f + broadcast(1);
+        p = p * f + broadcast(1);
+        __m128i scale = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+        return p * Float4{_mm_castsi128_ps(scale)};
+    }
+#else
+    float v[4];
+    static Float4 load(const float *p) {
+        return {{p[0], p[1], p[2], p[3]}};
+    }
+    static Float4 broadcast(float f) {
+        return {{f, f, f, f}};
+    }
+    void store(float *p) const {
+        for (int i = 0; i < 4; ++i)
+            p[i] = v[i];
+    }
+    Float4 operator+(Float4 o) const {
+        return {{v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]}};
+    }
+    Float4 operator-(Float4 o) const {
+        return {{v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3]}};
+    }
+    Float4 operator*(Float4 o) const {
+        return {{v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3]}};
+    }
+    Float4 operator/(Float4 o) const {
+        return {{v[0] / o.v[0], v[1] / o.v[1], v[2] / o.v[2], v[3] / o.v[3]}};
+    }
+    static Float4 min(Float4 a, Float4 b) {
+        return {{std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3])}};
+    }
+    static Float4 max(Float4 a, Float4 b) {
+        return {{std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3])}};
+    }
+    static Float4 abs(Float4 a) {
+        return {{std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3])}};
+    }
+    static Float4 sqrt(Float4 a) {
+        return {{std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])}};
+    }
+    static Float4 exp(Float4 x) {
+        x = min(max(x, broadcast(-87)), broadcast(88));
+        return {{std::exp(x.v[0]), std::exp(x.v[1]), std::exp(x.v[2]), std::exp(x.v[3])}};
+    }
+#endif
+};
+
+///@brief out[i] = sum of weights[k] * in[k][i] over k in [0, taps),
+/// summed in order of k; out may be one of the in rows
+inline void weightedSum(const float *const *in, const float *weights, int taps, float *out, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Float4 sum = Float4::broadcast(weights[0]) * Float4::load(in[0] + i);
+        for (int k = 1; k < taps; ++k) {
+            sum = sum + Float4::broadcast(weights[k]) * Float4::load(in[k] + i);
+        }
+        sum.store(out + i);
+    }
+    for (; i < n; ++i) {
+        float sum = weights[0] * in[0][i];
+        for (int k = 1; k < taps; ++k) {
+            sum += weights[k] * in[k][i];
+        }
+        out[i] = sum;
+    }
+}
+
+#endif // SIMD_H
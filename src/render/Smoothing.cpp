@@ -1,31 +1,118 @@
 #include "Smoothing.h"
+#include "Parallel.h"
+#include "Simd.h"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace std;
 
-void Smoothing::gaussian(Image &image, const float kernel[5]) {
+// floats per column strip of the vertical pass, so that the rows kept
+// for a strip stay in cache
+#define STRIP_FLOATS 1536
+
+static const char *filterNames[NUM_FILTERS] = {"gaussian", "tent", "mitchell", "lanczos"};
+
+FilterKernel Smoothing::fromName(const char *name) {
+    int i = 0;
+    while (i < NUM_FILTERS && strcmp(filterNames[i], name) != 0) {
+        ++i;
+    }
+    return (FilterKernel)i;
+}
+
+static float mitchell(float x) {
+    const float B = 1.0f / 3, C = 1.0f / 3;
+    x = fabsf(x);
+    if (x < 1)
+        return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6;
+    if (x < 2)
+        return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6;
+    return 0;
+}
+
+static float sinc(float x) {
+    if (fabsf(x) < 1e-5f)
+        return 1;
+    return sin(M_PI * x) / (M_PI * x);
+}
+
+static float lanczos(float x) {
+    const float LOBES = 3;
+    return fabsf(x) < LOBES ? sinc(x) * sinc(x / LOBES) : 0;
+}
+
+vector<float> Smoothing::weights(FilterKernel kernel, float radius) {
+    int r = ceil(radius);
+    vector<float> w(2 * r + 1);
+    float total = 0;
+    for (int i = -r; i <= r; ++i) {
+        float x = i / radius;
+        switch (kernel) {
+        case FILTER_GAUSSIAN:
+            // three standard deviations within the radius
+            w[i + r] = exp(-4.5f * x * x);
+            break;
+        case FILTER_TENT:
+            w[i + r] = max(0.0f, 1 - fabsf(x));
+            break;
+        case FILTER_MITCHELL:
+            w[i + r] = mitchell(2 * x);
+            break;
+        default:
+            w[i + r] = lanczos(3 * x);
+            break;
+        }
+        total += w[i + r];
+    }
+    for (auto &weight : w) {
+        weight /= total;
+    }
+    return w;
+}
+
+void Smoothing::separable(Image &image, const vector<float> &weights) {
+    TRACE_SCOPE("filter");
     int w = image.getWidth(), h = image.getHeight();
-    Image res(w, h);
-    for (int i = 0; i < w; ++i) {
-        for (int j = 0; j < h; ++j) {
-            Vector3f color;
-            for (int k = 0; k < 5; ++k) {
-                int y = max(0, min(j - 2 + k, h - 1));
-                color += kernel[k] * image.getPixel(i, y);
+    int taps = weights.size(), r = taps / 2;
+    assert(taps % 2 == 1);
+    int rowFloats = 3 * w;
+    float *data = (float *)image.getRow(0);
+
+    // columns, on strips of the rows; the last r + 1 rows of a strip are
+    // kept before they are overwritten, the rows below are still unfiltered
+    int strips = (rowFloats + STRIP_FLOATS - 1) / STRIP_FLOATS;
+    parallelFor(0, strips, [&](int s0, int s1) {
+        vector<float> ring((r + 1) * STRIP_FLOATS);
+        vector<const float *> in(taps);
+        for (int s = s0; s < s1; ++s) {
+            int f0 = s * STRIP_FLOATS, n = min(STRIP_FLOATS, rowFloats - f0);
+            for (int y = 0; y < h; ++y) {
+                float *kept = &ring[y % (r + 1) * STRIP_FLOATS];
+                copy(data + y * rowFloats + f0, data + y * rowFloats + f0 + n, kept);
+                for (int k = 0; k < taps; ++k) {
+                    int sy = max(0, min(y - r + k, h - 1));
+                    in[k] = sy <= y ? &ring[sy % (r + 1) * STRIP_FLOATS] : data + sy * rowFloats + f0;
+                }
+                weightedSum(in.data(), weights.data(), taps, data + y * rowFloats + f0, n);
             }
-            res.setPixel(i, j, color);
         }
-    }
-    image.setImage(res);
-    for (int i = 0; i < w; ++i) {
-        for (int j = 0; j < h; ++j) {
-            Vector3f color;
-            for (int k = 0; k < 5; ++k) {
-                int x = max(0, min(i - 2 + k, w - 1));
-                color += kernel[k] * image.getPixel(x, j);
+    });
+
+    // rows, each copied with its borders clamped first
+    parallelFor(0, h, [&](int y0, int y1) {
+        vector<float> padded(3 * (w + 2 * r));
+        vector<const float *> in(taps);
+        for (int k = 0; k < taps; ++k) {
+            in[k] = &padded[3 * k];
+        }
+        for (int y = y0; y < y1; ++y) {
+            float *row = data + y * rowFloats;
+            for (int x = -r; x < w + r; ++x) {
+                int sx = max(0, min(x, w - 1));
+                copy(row + 3 * sx, row + 3 * sx + 3, &padded[3 * (x + r)]);
             }
-            res.setPixel(i, j, color);
+            weightedSum(in.data(), weights.data(), taps, row, rowFloats);
         }
-    }
-    image.setImage(res);
+    });
 }
@@ -1,12 +1,30 @@
 #ifndef SMOOTHING_H
 #define SMOOTHING_H
 
-#include "Arguments.h"
 #include "Image.h"
+#include <vector>
+
+enum FilterKernel {
+    FILTER_GAUSSIAN,
+    FILTER_TENT,
+    // Mitchell-Netravali with B = C = 1/3
+    FILTER_MITCHELL,
+    // Lanczos with 3 lobes
+    FILTER_LANCZOS,
+    NUM_FILTERS
+};
 
 class Smoothing {
 public:
-    static void gaussian(Image &image, const float kernel[5]);
+    ///@return the kernel called name, or NUM_FILTERS if there is none
+    static FilterKernel fromName(const char *name);
+    ///@brief normalized weights of kernel, stretched to radius pixels, at
+    /// the integer offsets -ceil(radius)..ceil(radius)
+    static std::vector<float> weights(FilterKernel kernel, float radius);
+    ///@brief convolves image in place with weights (an odd number of
+    /// taps, centered) along columns, then along rows, clamped at the
+    /// borders; both passes run on strips in parallel
+    static void separable(Image &image, const std::vector<float> &weights);
 };
 
 #endif // SMOOTHING_H
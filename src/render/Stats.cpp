@@ -0,0 +1,136 @@
+#include "Stats.h"
+#include "../data/Scene.h"
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+static const char *statNames[NUM_STAT_COUNTERS] = {
+    "primary rays",
+    "reflection rays",
+    "refraction rays",
+    "shadow rays",
+    "bvh nodes",
+    "octree nodes",
+    "triangle tests",
+    "sphere tests",
+    "plane tests",
+    "hits",
+};
+
+#ifdef RENDER_STATS
+// the counters of every thread that has counted, kept after the thread
+// ends so that they are still merged
+static mutex statsMutex;
+static vector<unique_ptr<ThreadStats>> threadStats;
+// the blocks of the threads that have ended, with their counts, which
+// new threads count on; there are as many blocks as threads counting at
+// once, not as threads started
+static vector<ThreadStats *> freeStats;
+
+///@brief gives the block of a thread back when the thread ends
+struct StatsRelease {
+    ThreadStats *stats;
+    ~StatsRelease() {
+        lock_guard<mutex> lock(statsMutex);
+        freeStats.push_back(stats);
+    }
+};
+
+ThreadStats &RenderStats::local() {
+    thread_local ThreadStats *stats = NULL;
+    if (stats == NULL) {
+        {
+            lock_guard<mutex> lock(statsMutex);
+            if (!freeStats.empty()) {
+                stats = freeStats.back();
+                freeStats.pop_back();
+            } else {
+                threadStats.push_back(make_unique<ThreadStats>());
+                stats = threadStats.back().get();
+            }
+        }
+        // only the first call of a thread constructs it, so the counting
+        // itself stays a plain thread local pointer
+        thread_local StatsRelease release{stats};
+    }
+    return *stats;
+}
+
+RenderStats RenderStats::merged() {
+    lock_guard<mutex> lock(statsMutex);
+    RenderStats sum;
+    for (auto &stats : threadStats) {
+        for (int i = 0; i < NUM_STAT_COUNTERS; ++i) {
+            sum.counters[i] += stats->counters[i].load(memory_order_relaxed);
+        }
+        lock_guard<mutex> shadingLock(stats->shadingMutex);
+        for (auto &[material, calls] : stats->shading) {
+            sum.shading[material] += calls.load(memory_order_relaxed);
+        }
+    }
+    return sum;
+}
+
+bool RenderStats::enabled() {
+    return true;
+}
+#else
+ThreadStats &RenderStats::local() {
+    static ThreadStats none;
+    return none;
+}
+
+RenderStats RenderStats::merged() {
+    return RenderStats();
+}
+
+bool RenderStats::enabled() {
+    return false;
+}
+#endif
+
+RenderStats RenderStats::operator-(const RenderStats &before) const {
+    RenderStats res = *this;
+    for (int i = 0; i < NUM_STAT_COUNTERS; ++i) {
+        res.counters[i] -= before.counters[i];
+    }
+    for (auto &[material, calls] : before.shading) {
+        res.shading[material] -= calls;
+    }
+    return res;
+}
+
+void RenderStats::print(ostream &os, const Scene &scene) const {
+    if (!enabled()) {
+        os << "Statistics are compiled out, rebuild with make clean && make STATS=1" << endl;
+        return;
+    }
+    const RenderStats &stats = *this;
+    long long rays = 0;
+    for (int i = STAT_PRIMARY_RAYS; i <= STAT_SHADOW_RAYS; ++i) {
+        rays += stats.counters[i];
+    }
+    os << "Statistics:" << endl;
+    for (int i = 0; i < NUM_STAT_COUNTERS; ++i) {
+        os << "  " << left << setw(18) << statNames[i] << right << setw(14) << stats.counters[i];
+        if (i > STAT_SHADOW_RAYS && rays > 0) {
+            os << "  " << fixed << setprecision(2) << (double)stats.counters[i] / rays << " per ray";
+        }
+        os << endl;
+    }
+    vector<pair<int, long long>> shading;
+    for (auto &[material, calls] : stats.shading) {
+        // materials only shaded before the counts were taken
+        if (calls > 0) {
+            shading.push_back({scene.getMaterialIndex(material), calls});
+        }
+    }
+    sort(shading.begin(), shading.end());
+    for (auto &[index, calls] : shading) {
+        os << "  shading material " << left << setw(2) << index << right << setw(14) << calls << endl;
+    }
+}
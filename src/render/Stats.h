@@ -0,0 +1,109 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+class Material;
+class Scene;
+
+enum StatCounter {
+    STAT_PRIMARY_RAYS,
+    STAT_REFLECTION_RAYS,
+    STAT_REFRACTION_RAYS,
+    STAT_SHADOW_RAYS,
+    STAT_BVH_NODES,
+    STAT_OCTREE_NODES,
+    STAT_TRIANGLE_TESTS,
+    STAT_SPHERE_TESTS,
+    STAT_PLANE_TESTS,
+    STAT_HITS,
+    NUM_STAT_COUNTERS
+};
+
+///@brief bvh and octree nodes visited and intersection tests
+template <typename Counters> long long countSteps(const Counters &counters) {
+    return counters[STAT_BVH_NODES] + counters[STAT_OCTREE_NODES] + counters[STAT_TRIANGLE_TESTS] +
+           counters[STAT_SPHERE_TESTS] + counters[STAT_PLANE_TESTS];
+}
+
+///@brief the counters of one thread, which only that thread writes while
+/// RenderStats::merged() may read them from another; the counters are
+/// atomic, but incremented with a relaxed load and store, so counting
+/// costs the same as with plain ones
+struct ThreadStats {
+    std::atomic<long long> counters[NUM_STAT_COUNTERS] = {};
+    // shading calls by material; a material is only added under the
+    // mutex, which merged() holds while it reads the map
+    std::map<const Material *, std::atomic<long long>> shading;
+    std::mutex shadingMutex;
+
+    void add(StatCounter counter, long long n) {
+        counters[counter].store(counters[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void shade(const Material *material) {
+        auto it = shading.find(material);
+        if (it == shading.end()) {
+            std::lock_guard<std::mutex> lock(shadingMutex);
+            it = shading.try_emplace(material, 0).first;
+        }
+        it->second.store(it->second.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    long long steps() const {
+        return countSteps(counters);
+    }
+};
+
+///@brief counts of the work done while rendering, kept per thread and
+/// merged when printed; only compiled in with RENDER_STATS defined
+/// (make STATS=1), otherwise the STAT_ macros expand to nothing
+struct RenderStats {
+    long long counters[NUM_STAT_COUNTERS] = {};
+    // shading calls by material
+    std::map<const Material *, long long> shading;
+
+    ///@brief the counters of the calling thread
+    static ThreadStats &local();
+    ///@brief the sum of the counters of all threads, which only grow, so
+    /// the work of a render is the difference of two of these; it can be
+    /// taken while other threads count
+    static RenderStats merged();
+    static bool enabled();
+    ///@brief the counts of this minus those of before
+    RenderStats operator-(const RenderStats &before) const;
+    ///@brief bvh and octree nodes visited and intersection tests
+    long long steps() const {
+        return countSteps(counters);
+    }
+    ///@brief prints the counters, materials by their index in scene
+    void print(std::ostream &os, const Scene &scene) const;
+};
+
+///@brief time stamp counter, in cycles on x86 and nanoseconds elsewhere
+inline unsigned long long cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+#ifdef RENDER_STATS
+#define STAT_INC(counter) (RenderStats::local().add(counter, 1))
+#define STAT_ADD(counter, n) (RenderStats::local().add(counter, (n)))
+#define STAT_SHADE(material) (RenderStats::local().shade(material))
+#else
+#define STAT_INC(counter) ((void)0)
+#define STAT_ADD(counter, n) ((void)0)
+#define STAT_SHADE(material) ((void)0)
+#endif
+
+#endif // STATS_H
@@ -0,0 +1,40 @@
+#include "ToneMapping.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static const char *toneMapNames[NUM_TONEMAPS] = {"clamp", "reinhard", "aces"};
+
+ToneMapOperator ToneMapping::fromName(const char *name) {
+    int i = 0;
+    while (i < NUM_TONEMAPS && strcmp(toneMapNames[i], name) != 0) {
+        ++i;
+    }
+    return (ToneMapOperator)i;
+}
+
+static float toneMap(float c, ToneMapOperator op) {
+    c = max(c, 0.0f);
+    switch (op) {
+    case TONEMAP_REINHARD:
+        return c / (1 + c);
+    case TONEMAP_ACES:
+        return min(1.0f, c * (2.51f * c + 0.03f) / (c * (2.43f * c + 0.59f) + 0.14f));
+    default:
+        return min(c, 1.0f);
+    }
+}
+
+void ToneMapping::apply(Image &image, ToneMapOperator op, float exposure) {
+    TRACE_SCOPE("tone mapping");
+    float scale = pow(2.0f, exposure);
+    for (int i = 0; i < image.getWidth(); ++i) {
+        for (int j = 0; j < image.getHeight(); ++j) {
+            Vector3f c = scale * image.getPixel(i, j);
+            image.setPixel(i, j, Vector3f(toneMap(c[0], op), toneMap(c[1], op), toneMap(c[2], op)));
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef TONEMAPPING_H
+#define TONEMAPPING_H
+
+#include "Image.h"
+
+enum ToneMapOperator {
+    // scale only, values over 1 are clipped when saved
+    TONEMAP_CLAMP,
+    // c / (1 + c)
+    TONEMAP_REINHARD,
+    // Narkowicz's fit of the ACES filmic curve
+    TONEMAP_ACES,
+    NUM_TONEMAPS
+};
+
+class ToneMapping {
+public:
+    ///@return the operator called name, or NUM_TONEMAPS if there is none
+    static ToneMapOperator fromName(const char *name);
+    ///@brief scales the image by 2^exposure and maps it to [0, 1] with op,
+    /// for 8-bit output of a float image
+    static void apply(Image &image, ToneMapOperator op, float exposure);
+};
+
+#endif // TONEMAPPING_H
@@ -0,0 +1,163 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// spans kept per thread, the oldest are overwritten past this
+#define TRACE_CAPACITY 16384
+
+struct TraceBuffer {
+    int thread;
+    // spans recorded since start, only the last TRACE_CAPACITY are kept
+    atomic<long long> count{0};
+    TraceEvent events[TRACE_CAPACITY];
+};
+
+atomic<bool> Trace::recording{false};
+
+static chrono::steady_clock::time_point traceStart;
+// the buffers of every thread that has recorded, kept after the thread
+// ends so that its spans are still written
+static mutex traceMutex;
+static vector<unique_ptr<TraceBuffer>> traceBuffers;
+// the buffers of the threads that have ended, which new threads record
+// into after their spans; there are as many buffers, and tracks, as
+// threads recording at once, not as threads started
+static vector<TraceBuffer *> freeBuffers;
+
+///@brief gives the buffer of a thread back when the thread ends
+struct TraceRelease {
+    TraceBuffer *buffer;
+    ~TraceRelease() {
+        lock_guard<mutex> lock(traceMutex);
+        freeBuffers.push_back(buffer);
+    }
+};
+
+static TraceBuffer &localBuffer() {
+    thread_local TraceBuffer *buffer = NULL;
+    if (buffer == NULL) {
+        {
+            lock_guard<mutex> lock(traceMutex);
+            if (!freeBuffers.empty()) {
+                buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            } else {
+                traceBuffers.push_back(make_unique<TraceBuffer>());
+                buffer = traceBuffers.back().get();
+                buffer->thread = traceBuffers.size() - 1;
+            }
+        }
+        // only the first span of a thread constructs it, so recording
+        // itself stays a plain thread local pointer
+        thread_local TraceRelease release{buffer};
+    }
+    return *buffer;
+}
+
+void Trace::start() {
+    lock_guard<mutex> lock(traceMutex);
+    for (auto &buffer : traceBuffers) {
+        buffer->count = 0;
+    }
+    traceStart = chrono::steady_clock::now();
+    recording = true;
+}
+
+long long Trace::now() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - traceStart).count();
+}
+
+void Trace::record(const TraceEvent &event) {
+    TraceBuffer &buffer = localBuffer();
+    long long n = buffer.count.load(memory_order_relaxed);
+    buffer.events[n % TRACE_CAPACITY] = event;
+    buffer.count.store(n + 1, memory_order_release);
+}
+
+///@brief writes s as the contents of a JSON string
+static void writeJsonString(FILE *file, const char *s) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*s >= 0x20) {
+            fputc(*s, file);
+        }
+    }
+}
+
+bool Trace::write(const char *filename) {
+    recording = false;
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        return false;
+    }
+    lock_guard<mutex> lock(traceMutex);
+    fprintf(file, "{\"traceEvents\": [\n");
+    bool first = true;
+    long long dropped = 0;
+    for (auto &buffer : traceBuffers) {
+        long long count = buffer->count.load(memory_order_acquire);
+        if (count == 0) {
+            continue;
+        }
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                first ? "" : ",\n", buffer->thread, buffer->thread == 0 ? "main" : "worker", buffer->thread);
+        first = false;
+        long long begin = max(0LL, count - TRACE_CAPACITY);
+        dropped += begin;
+        for (long long i = begin; i < count; ++i) {
+            const TraceEvent &e = buffer->events[i % TRACE_CAPACITY];
+            fprintf(file, ",\n{\"name\": \"");
+            writeJsonString(file, e.name);
+            fprintf(file, "\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %lld, \"dur\": %lld, \"args\": {",
+                    buffer->thread, e.begin, e.end - e.begin);
+            const char *separator = "";
+            if (e.detail[0] != '\0') {
+                fprintf(file, "\"detail\": \"");
+                writeJsonString(file, e.detail);
+                fprintf(file, "\"");
+                separator = ", ";
+            }
+            for (int k = 0; k < 2; ++k) {
+                if (e.args[k] >= 0) {
+                    fprintf(file, "%s\"%c\": %d", separator, "xy"[k], e.args[k]);
+                    separator = ", ";
+                }
+            }
+            fprintf(file, "}}");
+        }
+    }
+    fprintf(file, "\n],\n\"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped\": %lld}}\n", dropped);
+    fclose(file);
+    return true;
+}
+
+TraceSpan::TraceSpan(const char *name, const char *detail, int arg0, int arg1) {
+    if (!Trace::enabled()) {
+        return;
+    }
+    event.name = name;
+    if (detail != NULL) {
+        // the end of a long path, where the file name is
+        size_t len = strlen(detail), keep = sizeof(event.detail) - 1;
+        strcpy(event.detail, detail + (len > keep ? len - keep : 0));
+    }
+    event.args[0] = arg0;
+    event.args[1] = arg1;
+    event.begin = Trace::now();
+}
+
+TraceSpan::~TraceSpan() {
+    if (event.name != NULL) {
+        event.end = Trace::now();
+        Trace::record(event);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+
+///@brief a span of time spent on one thread, with an optional detail
+/// such as a file name and up to two integer arguments
+struct TraceEvent {
+    const char *name = NULL;
+    char detail[40] = {};
+    int args[2] = {-1, -1};
+    long long begin = 0;
+    long long end = 0;
+};
+
+///@brief timeline of the load and render phases, written as a Chrome
+/// trace (chrome://tracing or ui.perfetto.dev) with a track per thread
+///
+/// every thread records into a ring buffer of its own, registered the
+/// first time it records, so recording a span takes no lock; the
+/// oldest spans of a thread are overwritten when its buffer is full. A
+/// thread that ends leaves its buffer, and its track, to the next new
+/// thread, so the threads of successive passes share the tracks of
+/// as many workers as run at once
+class Trace {
+public:
+    ///@brief clears what was recorded and starts recording
+    static void start();
+    static bool enabled() {
+        return recording.load(std::memory_order_relaxed);
+    }
+    ///@brief microseconds since start
+    static long long now();
+    ///@brief records a span on the calling thread
+    static void record(const TraceEvent &event);
+    ///@brief stops recording and writes the spans of all threads, it
+    /// must not race with threads still recording
+    ///@return false if filename cannot be written
+    static bool write(const char *filename);
+
+private:
+    static std::atomic<bool> recording;
+};
+
+///@brief records the span from its construction to its destruction when
+/// tracing, name must outlive the trace
+class TraceSpan {
+public:
+    TraceSpan(const char *name, const char *detail = NULL, int arg0 = -1, int arg1 = -1);
+    ~TraceSpan();
+
+private:
+    TraceEvent event;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+///@brief traces the rest of the enclosing scope
+#define TRACE_SCOPE(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_H
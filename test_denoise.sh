@@ -0,0 +1,13 @@
+#!/bin/sh
+# quality and speed of the denoiser: renders at a few samples per pixel,
+# with and without -denoise, against a 64 spp reference
+mkdir -p output
+
+./proj -input scene/default/scene13_diamond.txt -size 200 200 -output output/denoise_ref.pfm\
+ -light-samples 1 -spp 64 | grep -E "Progressive"
+for spp in 1 2 4; do
+    ./proj -input scene/default/scene13_diamond.txt -size 200 200 -output output/denoise_${spp}.bmp\
+     -light-samples 1 -spp $spp -reference output/denoise_ref.pfm | grep -E "Progressive|PSNR"
+    ./proj -input scene/default/scene13_diamond.txt -size 200 200 -output output/denoise_${spp}_denoised.bmp\
+     -light-samples 1 -spp $spp -denoise -reference output/denoise_ref.pfm | grep -E "Progressive|Denoising|PSNR"
+done
@@ -0,0 +1,23 @@
+#!/bin/sh
+# builds librender and the example client of examples/, which loads a
+# scene once and renders it at two sizes; its images must match those
+# of the command line
+set -e
+mkdir -p output
+make lib
+g++ -std=c++20 -O2 -pthread -Isrc -Ivecmath/include examples/render_context.cpp librender.a -o output/render_context
+
+OPTIONS="-shadows -bounces 4"
+./output/render_context scene/default/scene10_sphere.txt output/librender 120x90 60x45 -- $OPTIONS
+for size in "120 90" "60 45"; do
+    set -- $size
+    ./proj -input scene/default/scene10_sphere.txt -size $1 $2 -output output/cli_$1x$2.ppm $OPTIONS > /dev/null
+    # the pixels, after the headers
+    bytes=$(($1 * $2 * 3))
+    if [ "$(tail -c $bytes output/librender_$1x$2.ppm | md5sum)" = "$(tail -c $bytes output/cli_$1x$2.ppm | md5sum)" ]; then
+        echo "$1x$2 matches the command line"
+    else
+        echo "$1x$2 differs from the command line"
+        exit 1
+    fi
+done